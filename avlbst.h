@@ -3,373 +3,211 @@
 
 #include <iostream>
 #include <exception>
+#include <stdexcept>
+#include <cmath>
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <vector>
 #include "bst.h"
 
 struct KeyError { };
 
 /**
-* A special kind of node for an AVL tree, which adds the balance as a data member, plus
-* other additional helper functions. You do NOT need to implement any functionality or
-* add additional data members or helper functions.
+* A self-balancing AVL tree.  NodeT defaults to AVLNode and may be any node
+* type derived from it that redefines the link getters to return NodeT.
+* AVLNode is BinarySearchTree's default node as well, so AVLTree<Key, Value>
+* derives from BinarySearchTree<Key, Value> and can be passed wherever one
+* is expected; insert and remove still rebalance through the base class.
 */
-template <typename Key, typename Value>
-class AVLNode : public Node<Key, Value>
+template <class Key, class Value, class Compare = std::less<Key>,
+          class NodeT = AVLNode<Key, Value>, class Alloc = NodePool<NodeT> >
+class AVLTree : public BinarySearchTree<Key, Value, Compare, NodeT, Alloc>
 {
 public:
-    // Constructor/destructor.
-    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
-
-    // Getter/setter for the node's height.
-    int8_t getBalance () const;
-    void setBalance (int8_t balance);
-    void updateBalance(int8_t diff);
-
-    // Getters for parent, left, and right. These need to be redefined since they
-    // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
-    // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
-
+    AVLTree();
+    explicit AVLTree(const Compare& comp);
+    template<typename ForwardIt>
+    AVLTree(ForwardIt first, ForwardIt last, const Compare& comp = Compare());
+    AVLTree(AVLTree&& other);
+    AVLTree& operator=(AVLTree&& other);
+    virtual void remove(const Key& key);
+    virtual bool isBalanced() const;
+    virtual void validate() const;
+    int height() const;
+
+    std::pair<AVLTree, AVLTree> split(const Key& key);
+    static AVLTree join(AVLTree&& left, AVLTree&& right);
+    static AVLTree join(AVLTree&& left, const std::pair<const Key, Value>& pivot, AVLTree&& right);
+
+    // Set operations on keys; items in both trees keep left's value
+    static AVLTree setUnion(AVLTree&& left, AVLTree&& right);
+    static AVLTree setIntersection(AVLTree&& left, AVLTree&& right);
+    static AVLTree setDifference(AVLTree&& left, AVLTree&& right);
 protected:
-    int8_t balance_;    // effectively a signed char
-};
+    virtual void nodeSwap( NodeT* n1, NodeT* n2);
+    virtual void leafAdded(NodeT* n);
 
-/*
-  -------------------------------------------------
-  Begin implementations for the AVLNode class.
-  -------------------------------------------------
-*/
+    // Add helper functions here
+		bool insertFix(NodeT* p, NodeT* n);
+		void unlinkNode(NodeT* toDelete);
+		static int spineHeight(NodeT* root);
+		void splitHelper(NodeT* root, int height, const Key& key,
+			NodeT*& left, int& lHeight, NodeT*& match, NodeT*& right, int& rHeight);
+		NodeT* joinRoots(NodeT* left, int lHeight, NodeT* pivot, NodeT* right, int rHeight, int& height);
+		NodeT* joinPair(NodeT* left, int lHeight, NodeT* right, int rHeight, int& height);
+		NodeT* adopt(AVLTree& other);
+
+		typedef NodeT* (AVLTree::*SetOp)(std::vector<NodeT*>& garbage,
+			NodeT* a, int aHeight, NodeT* b, int bHeight, int& height);
+		static AVLTree setOperation(SetOp op, AVLTree&& left, AVLTree&& right);
+		NodeT* unionRoots(std::vector<NodeT*>& garbage,
+			NodeT* a, int aHeight, NodeT* b, int bHeight, int& height);
+		NodeT* intersectRoots(std::vector<NodeT*>& garbage,
+			NodeT* a, int aHeight, NodeT* b, int bHeight, int& height);
+		NodeT* differenceRoots(std::vector<NodeT*>& garbage,
+			NodeT* a, int aHeight, NodeT* b, int bHeight, int& height);
+
+		void rotateRight(NodeT* node);
+		void rotateLeft(NodeT* node);
+		void removeFix(NodeT* n, int diff);
+
+};
 
 /**
-* An explicit constructor to initialize the elements by calling the base class constructor
+* Default constructor for an empty tree.
 */
-template<class Key, class Value>
-AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>::AVLTree()
 {
 
 }
 
 /**
-* A destructor which does nothing.
+* Constructs an empty tree ordered by comp.
 */
-template<class Key, class Value>
-AVLNode<Key, Value>::~AVLNode()
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>::AVLTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>(comp)
 {
 
 }
 
 /**
-* A getter for the balance of a AVLNode.
+* Builds a perfectly height-balanced tree in linear time from a range
+* sorted by key with no duplicate keys; see BinarySearchTree::assign().
 */
-template<class Key, class Value>
-int8_t AVLNode<Key, Value>::getBalance() const
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename ForwardIt>
+AVLTree<Key, Value, Compare, NodeT, Alloc>::AVLTree(ForwardIt first, ForwardIt last, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>(first, last, comp)
 {
-    return balance_;
-}
 
-/**
-* A setter for the balance of a AVLNode.
-*/
-template<class Key, class Value>
-void AVLNode<Key, Value>::setBalance(int8_t balance)
-{
-    balance_ = balance;
 }
 
 /**
-* Adds diff to the balance of a AVLNode.
+* Takes over other's nodes, leaving other empty.
 */
-template<class Key, class Value>
-void AVLNode<Key, Value>::updateBalance(int8_t diff)
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>::AVLTree(AVLTree&& other) :
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>(std::move(other))
 {
-    balance_ += diff;
-}
 
-/**
-* An overridden function for getting the parent since a static_cast is necessary to make sure
-* that our node is a AVLNode.
-*/
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
-{
-    return static_cast<AVLNode<Key, Value>*>(this->parent_);
 }
 
-/**
-* Overridden for the same reasons as above.
-*/
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>&
+AVLTree<Key, Value, Compare, NodeT, Alloc>::operator=(AVLTree&& other)
 {
-    return static_cast<AVLNode<Key, Value>*>(this->left_);
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::operator=(std::move(other));
+    return *this;
 }
 
 /**
-* Overridden for the same reasons as above.
-*/
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
+ * Rebalances after any insert path has linked in the new leaf n.  The
+ * base class's insert, emplace and try_emplace descend once to the
+ * insertion point; this retraces only as far as the subtree heights
+ * keep growing.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void AVLTree<Key, Value, Compare, NodeT, Alloc>::leafAdded(NodeT* n)
 {
-    return static_cast<AVLNode<Key, Value>*>(this->right_);
+	NodeT* p = n->getParent();
+	SubtreeSize<NodeT::TRACKS_SIZE>::updatePath(p);
+	insertFix(p, n);
 }
 
-
-/*
-  -----------------------------------------------
-  End implementations for the AVLNode class.
-  -----------------------------------------------
-*/
-
-
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
-{
-public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
-    virtual void remove(const Key& key);  // TODO
-protected:
-    virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
-
-    // Add helper functions here
-		AVLNode<Key, Value>* insertHelper(
-			AVLNode<Key, Value>* root, 
-			const std::pair<const Key, Value>& new_item, 
-			AVLNode<Key, Value>* parent, 
-			AVLNode<Key, Value>*& added
-			);
-		void insertFix(AVLNode<Key, Value>* p, AVLNode<Key, Value>* n);
-		void rotateRight(AVLNode<Key, Value>* node);
-		void rotateLeft(AVLNode<Key, Value>* node);
-		void removeFix(AVLNode<Key, Value>* n, int diff);
-		int getHeight(AVLNode<Key, Value>* root);
-
-};
-
-/*
- * Recall: If key is already in the tree, you should 
- * overwrite the current value with the updated value.
+/**
+ * Retraces from p, whose child subtree n just grew by one level.
+ * Stops as soon as a balance returns to 0 (case 1) or a rotation
+ * restores the subtree's previous height (case 3).  Returns true
+ * if the retrace ran past the root, i.e. the whole tree grew.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool AVLTree<Key, Value, Compare, NodeT, Alloc>::insertFix(NodeT* p, NodeT* n) 
 {
-	// TODO
-	AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::root_);
-	//AVLNode<Key, Value>* added = insertHelper(root, new_item, NULL);
-	AVLNode<Key, Value>* added = NULL;
-	BinarySearchTree<Key, Value>::root_ = insertHelper(root, new_item, NULL, added);
-
-	//if tree was empty, update root 
-	/*if (BinarySearchTree<Key, Value>::root_ == NULL) {
-		BinarySearchTree<Key, Value>::root_ = added;
-	}*/
+	while (p != NULL) {
+		// -1 if n is p's left child, 1 if it is the right child
+		int8_t side = (p->getLeft() == n) ? -1 : 1;
+		int8_t balance = p->getBalance() + side;
 
-	AVLNode<Key, Value>* p = added->getParent();
-	//std::cout << added->getKey()<< std::endl;
-
-	// update parent's balance after adding 
-	
-	if (p != NULL && added != root) {
-		if (std::abs(p->getBalance()) == 1) {
+		if (balance == 0) { // case 1
 			p->setBalance(0);
-		} else { // parent's balance was = 0 
-			if (p->getLeft() == added) { // added to left 
-				p->setBalance(-1);
-			} else { // added to right 
-				p->setBalance(1);
-			}
-			insertFix(p, added);
+			return false;
 		}
-		//std::cout << "p: " << p->getKey() << " after balancing is " << static_cast<int>(p->getBalance()) << std::endl;
-
-	}
-	
-	
-}
-
-template<class Key, class Value>
-AVLNode<Key, Value>* AVLTree<Key, Value>::insertHelper(
-	AVLNode<Key, Value>* root, 
-	const std::pair<const Key, Value>& new_item, 
-	AVLNode<Key, Value>* parent, 
-	AVLNode<Key, Value>*& newNode
-	) 
-{
-	if (root == NULL) {
-		AVLNode<Key, Value>* added = new AVLNode<Key, Value>(new_item.first, new_item.second, parent);
-		//insertFix(parent, added);
-		newNode = added;
-		return added;
-	}
-
-	if (root->getKey() == new_item.first) {
-		// replace 
-		root->setValue(new_item.second);
-		newNode = root;
-		return root;
-	}
-
-	//recurse down 
-	if (new_item.first < root->getKey()) {
-		// go to left 
-		root->setLeft(insertHelper(root->getLeft(), new_item, root, newNode));
-		root->getLeft()->setParent(root);
-	} else {
-		// go to right 
-		root->setRight(insertHelper(root->getRight(), new_item, root, newNode));
-		root->getRight()->setParent(root);
-	}
-	return root;
-}
-
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* p, AVLNode<Key, Value>* n) 
-{ // n is the newly added node, p is the parent of n. 
-	if (p == NULL || p->getParent() == NULL) return;
-
-	AVLNode<Key, Value>* g = p->getParent();
-	//check if p is left child of g 
-	int isLeft = (g->getLeft() == p) ? 1 : -1;
-	g->setBalance(g->getBalance() + -1*isLeft);
-	//std::cout << "g Balance : " << static_cast<int>(g->getBalance()) << std::endl;
-	if (g->getBalance() == 0) return; // case 1 
-	else if (g->getBalance() == -1 * isLeft) {
-		insertFix(g, p); // case 2
-	} else { // case 3
-		bool doubleCall = false;
-		if (isLeft == 1) {
-			if (g->getBalance() == -2 ) { 
-				if (g->getLeft() == p && p->getLeft() == n) {
-					// zig zig 
-					//rotateRight(p);
-					rotateRight(g);
-					p->setBalance(0);
-					g->setBalance(0);
-				} else {
-					// zig zag 
-					doubleCall = true;
-					//rotateLeft(n);
-					//rotateRight(n);
-					rotateLeft(p);
-					rotateRight(g);
-				}
-			}
-		} else { // isRight  
-			if (g->getBalance() == 2) { 
-				if (g->getRight() == p && p->getRight() == n) {
-					// zag zag 
-					//rotateLeft(p);
-					rotateLeft(g);
-					p->setBalance(0);
-					g->setBalance(0);
-				} else {
-					// zag zig 
-					doubleCall = true;
-					//rotateRight(n);
-					//rotateLeft(n);
-					rotateRight(p);
-					rotateLeft(g);
-				}
-			}
+		if (balance == side) { // case 2
+			p->setBalance(balance);
+			n = p;
+			p = p->getParent();
+			continue;
 		}
 
-		if (doubleCall) {
-			//redo balance factors: 
-			if (n->getBalance() == -1 * isLeft) { // 3a 
-				p->setBalance(0);
-				g->setBalance(1 * isLeft);
+		// case 3: p is now out of balance towards n
+		if (n->getBalance() == side) {
+			// zig zig 
+			this->counter().count(&TreeStats::insertZigZig);
+			if (side == -1) rotateRight(p);
+			else rotateLeft(p);
+			p->setBalance(0);
+			n->setBalance(0);
+		} else {
+			// zig zag 
+			this->counter().count(&TreeStats::insertZigZag);
+			NodeT* g = (side == -1) ? n->getRight() : n->getLeft();
+			if (side == -1) {
+				rotateLeft(n);
+				rotateRight(p);
+			} else {
+				rotateRight(n);
+				rotateLeft(p);
+			}
+			if (g->getBalance() == side) { // 3a 
 				n->setBalance(0);
-			} else if (n->getBalance() == 0) { // 3b 
-				p->setBalance(0);
-				g->setBalance(0);
+				p->setBalance(-side);
+			} else if (g->getBalance() == 0) { // 3b 
 				n->setBalance(0);
+				p->setBalance(0);
 			} else { // 3c 
-				p->setBalance(-1 * isLeft);
-				g->setBalance(0);
-				n->setBalance(0);
+				n->setBalance(side);
+				p->setBalance(0);
 			}
+			g->setBalance(0);
 		}
+		return false;
 	}
-
-}
-
-/*
-template <class Key, class Value>
-void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* p) {
-	//std::cout <<"rotate right" <<std::endl;
-	AVLNode<Key, Value>* g = p->getParent();
-	if (g == NULL) return;
-
-	AVLNode<Key, Value>* rChild = p->getRight();
-	AVLNode<Key, Value>* gg = g->getParent();
-	
-	// rotating 
-	p->setRight(g);
-	g->setLeft(rChild);	
-	if (rChild != NULL){
-		rChild->setParent(g);
-	}
-
-	g->setParent(p);	
-	p->setParent(gg);
-
-	if (gg == NULL) { // g is root 
-		BinarySearchTree<Key, Value>::root_ = p;
-	} else if (gg->getLeft() == g) {
-		gg->setLeft(p);
-	} else if (gg->getRight() == g) {
-		gg->setRight(p);
-	} 
-}
-*/
-/*
-template <class Key, class Value>
-void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* p) {
-	//std::cout <<"rotate left" <<std::endl;
-
-	AVLNode<Key, Value>* g = p->getParent();
-	if (g == NULL) return;
-
-	AVLNode<Key, Value>* lChild = p->getLeft();
-	AVLNode<Key, Value>* gg = g->getParent();
-	
-	// rotating 
-	p->setLeft(g);
-	g->setRight(lChild);	
-	if (lChild != NULL){
-		lChild->setParent(g);
-	}
-
-	// set parents 
-	g->setParent(p);	
-	p->setParent(gg);
-
-	if (gg == NULL) { // g is root 
-		BinarySearchTree<Key, Value>::root_ = p;
-	} else if (gg->getLeft() == g) {
-		gg->setLeft(p);
-	} else if (gg->getRight() == g) {
-		gg->setRight(p);
-	} 
-
+	return true;
 }
 
-*/ 
-
-
-template <class Key, class Value>
-void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* g) {
-	//std::cout <<"rotate right" <<std::endl;
-	//AVLNode<Key, Value>* g = p->getParent();
+/**
+ * Rotates g's left child up into g's place.
+ */
+template <class Key, class Value, class Compare, class NodeT, class Alloc>
+void AVLTree<Key, Value, Compare, NodeT, Alloc>::rotateRight(NodeT* g) {
 	if (g == NULL || g->getLeft() == NULL) return;
+	this->counter().count(&TreeStats::rotations);
 
-	AVLNode<Key, Value>* p = g->getLeft();
-	AVLNode<Key, Value>* rChild = p->getRight();
+	NodeT* p = g->getLeft();
+	NodeT* rChild = p->getRight();
 
 	
 	// rotating 
@@ -380,28 +218,33 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* g) {
 	}
 
 	// update parents 
-	AVLNode<Key, Value>* gg = g->getParent();
+	NodeT* gg = g->getParent();
 	p->setParent(gg);
 	g->setParent(p);	
 
 	if (gg == NULL) { // g is root 
-		BinarySearchTree<Key, Value>::root_ = p;
+		this->root_ = p;
 	} else if (gg->getLeft() == g) {
 		gg->setLeft(p);
 	} else if (gg->getRight() == g) {
 		gg->setRight(p);
 	} 
-}
 
-template <class Key, class Value>
-void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* g) {
-	//std::cout <<"rotate left" <<std::endl;
+	// g is now below p
+	SubtreeSize<NodeT::TRACKS_SIZE>::update(g);
+	SubtreeSize<NodeT::TRACKS_SIZE>::update(p);
+}
 
-	//AVLNode<Key, Value>* g = p->getParent();
+/**
+ * Rotates g's right child up into g's place.
+ */
+template <class Key, class Value, class Compare, class NodeT, class Alloc>
+void AVLTree<Key, Value, Compare, NodeT, Alloc>::rotateLeft(NodeT* g) {
 	if (g == NULL ||g ->getRight() == NULL) return;
+	this->counter().count(&TreeStats::rotations);
 
-	AVLNode<Key, Value>* p = g->getRight();
-	AVLNode<Key, Value>* lChild = p->getLeft();
+	NodeT* p = g->getRight();
+	NodeT* lChild = p->getLeft();
 	
 	// rotating 
 	p->setLeft(g);
@@ -411,120 +254,118 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* g) {
 	}
 
 	// set parents 
-	AVLNode<Key, Value>* gg = g->getParent();
+	NodeT* gg = g->getParent();
 
 	p->setParent(gg);	
 	g->setParent(p);
 
 	if (gg == NULL) { // g is root 
-		BinarySearchTree<Key, Value>::root_ = p;
+		this->root_ = p;
 	} else if (gg->getLeft() == g) {
 		gg->setLeft(p);
 	} else if (gg->getRight() == g) {
 		gg->setRight(p);
 	} 
 
+	// g is now below p
+	SubtreeSize<NodeT::TRACKS_SIZE>::update(g);
+	SubtreeSize<NodeT::TRACKS_SIZE>::update(p);
 }
 /*
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::remove(const Key& key)
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void AVLTree<Key, Value, Compare, NodeT, Alloc>::remove(const Key& key)
 {
-    // TODO
-	AVLNode<Key, Value>* toDelete = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::internalFind(key));
+	NodeT* toDelete = this->internalFind(key);
 	if (toDelete != NULL) {
-		
-		//comment this chunck out 
-		
-		if (toDelete->getRight() != NULL && toDelete->getLeft() != NULL) {
-			// 2 children exist. swap toDelete w its predecessor 
-			AVLNode<Key, Value>* pred = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::predecessor(toDelete)); //find predecessor 
-			AVLTree<Key, Value>::nodeSwap(toDelete, pred);
+		unlinkNode(toDelete);
+		this->destroyNode(toDelete);
+	}
+}
+
+/**
+ * Takes toDelete out of the tree and rebalances, without freeing it.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void AVLTree<Key, Value, Compare, NodeT, Alloc>::unlinkNode(NodeT* toDelete)
+{
+	this->removing(toDelete);
+	if (toDelete->getRight() != NULL && toDelete->getLeft() != NULL) {
+		// 2 children exist. swap toDelete w its predecessor 
+		NodeT* pred = this->predecessor(toDelete); //find predecessor 
+		AVLTree<Key, Value, Compare, NodeT, Alloc>::nodeSwap(toDelete, pred);
+	}
+	
+	NodeT* p = toDelete->getParent(); 
+	int diff = 0;
+	if (p != NULL) {
+		// toDelete is left child 
+		if (p->getLeft() == toDelete) {
+			diff = 1;
+		} else {
+			diff = -1;
 		}
-		
-		AVLNode<Key, Value>* p = toDelete->getParent(); 
-		int diff ;
-		if (p != NULL) {
-			// toDelete is left child 
-			if (p->getLeft() == toDelete) {
-				diff = 1;
-			} else {
-				diff = -1;
-			}
-		} 
-		/*
-		else {
-			//head is being deleted, determine if balances are disrupted 
-			if (toDelete->getLeft() != NULL) {
-				diff = -1;
-			} else if (toDelete->getRight() != NULL) {
-				diff = 1;
-			}
-		} 
-		*/
+	} 
 
-		// delete n 
+	// delete n 
 
-		// leaf node, just delete the node
-		if ((toDelete->getRight() == NULL) && (toDelete->getLeft() == NULL)) {
-			// check if head pointer 
-			if (toDelete == BinarySearchTree<Key, Value>::root_) {
-				BinarySearchTree<Key, Value>::root_ = NULL;
+	// leaf node, just delete the node
+	if ((toDelete->getRight() == NULL) && (toDelete->getLeft() == NULL)) {
+		// check if head pointer 
+		if (toDelete == this->root_) {
+			this->root_ = NULL;
+		} else {
+			//update parent pointer 
+			if (toDelete->getParent()->getRight() == toDelete) {
+				// toDelete's a right child 
+				toDelete->getParent()->setRight(NULL);
 			} else {
-				//update parent pointer 
-				if (toDelete->getParent()->getRight() == toDelete) {
-					// toDelete's a right child 
-					toDelete->getParent()->setRight(NULL);
-				} else {
-					// toDelete's a left child 
-					toDelete->getParent()->setLeft(NULL);
-				}
+				// toDelete's a left child 
+				toDelete->getParent()->setLeft(NULL);
 			}
-			delete toDelete;
-		} else {
-			if (toDelete->getRight() != NULL) {
-				// only right child exists
-				Node<Key, Value>* rChild = toDelete->getRight();
-				if (toDelete == BinarySearchTree<Key, Value>::root_) {
-					BinarySearchTree<Key, Value>::root_= rChild;
-					rChild->setParent(NULL);
-				} else {
-					Node<Key, Value>* parent = toDelete->getParent();
-					if (parent->getRight() == toDelete) {
-						//todelete is a right child of parent 
-						parent->setRight(rChild);
-					} else parent->setLeft(rChild);
-					rChild->setParent(parent);
-				}
-			} else if (toDelete->getLeft() != NULL){
-				// only left child exists
-				Node<Key, Value>* lChild = toDelete->getLeft();
-				if (toDelete == BinarySearchTree<Key, Value>::root_) {
-					BinarySearchTree<Key, Value>::root_ = lChild;
-					lChild->setParent(NULL);
-				} else {
-					Node<Key, Value>* parent = toDelete->getParent();
-					if (parent->getRight() == toDelete) {
-						//todelete is a right child of parent 
-						parent->setRight(lChild);
-					} else parent->setLeft(lChild);
-					lChild->setParent(parent);
-				}
+		}
+	} else {
+		if (toDelete->getRight() != NULL) {
+			// only right child exists
+			NodeT* rChild = toDelete->getRight();
+			if (toDelete == this->root_) {
+				this->root_= rChild;
+				rChild->setParent(NULL);
+			} else {
+				NodeT* parent = toDelete->getParent();
+				if (parent->getRight() == toDelete) {
+					//todelete is a right child of parent 
+					parent->setRight(rChild);
+				} else parent->setLeft(rChild);
+				rChild->setParent(parent);
+			}
+		} else if (toDelete->getLeft() != NULL){
+			// only left child exists
+			NodeT* lChild = toDelete->getLeft();
+			if (toDelete == this->root_) {
+				this->root_ = lChild;
+				lChild->setParent(NULL);
+			} else {
+				NodeT* parent = toDelete->getParent();
+				if (parent->getRight() == toDelete) {
+					//todelete is a right child of parent 
+					parent->setRight(lChild);
+				} else parent->setLeft(lChild);
+				lChild->setParent(parent);
 			}
-			delete toDelete;
 		}
-		//BinarySearchTree<Key, Value>::remove(key);
-		removeFix(p, diff);
 	}
+	SubtreeSize<NodeT::TRACKS_SIZE>::updatePath(p);
+	removeFix(p, diff);
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int diff)
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void AVLTree<Key, Value, Compare, NodeT, Alloc>::removeFix(NodeT* n, int diff)
 {
 	if (n == NULL) return;
-	AVLNode<Key, Value>* p = n->getParent();
+	NodeT* p = n->getParent();
 	int nDiff = 0;
 	if (p != NULL) {
 		if (p->getLeft() == n) nDiff = 1;
@@ -532,7 +373,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int diff)
 	}
 	if ( (n->getBalance() + diff) == 1 * diff){
 		// case 2 
-		n->setBalance(-1 * diff);
+		n->setBalance(diff);
 		return;
 	} else if ( (n->getBalance() + diff) == 0) {
 		// case 3 
@@ -541,11 +382,11 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int diff)
 	} else if ((n->getBalance() + diff) == 2 * diff) {
 		// case 1 
 		if (diff == -1) { // n is left child
-			AVLNode<Key, Value>* c = n->getLeft();
+			NodeT* c = n->getLeft();
 			if (c == NULL) return;
 			// case 1a  - zig zig 
 			if (c->getBalance() == -1) {
-				// old version of rotateRight - rotateRight(c); 
+				this->counter().count(&TreeStats::removeCase1a);
 				rotateRight(n);
 				n->setBalance(0);
 				c->setBalance(0);
@@ -553,7 +394,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int diff)
 			}
 			// case 1b  - zig zig 
 			else if (c->getBalance() == 0) {
-				//rotateRight(c);
+				this->counter().count(&TreeStats::removeCase1b);
 				rotateRight(n);
 				n->setBalance(-1);
 				c->setBalance(1);
@@ -561,9 +402,8 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int diff)
 			}
 			// case 1c - zig zag 
 			else if (c->getBalance() == 1) {
-				AVLNode<Key, Value>* g = c->getRight();
-				//rotateLeft(g);
-				//rotateRight(c);
+				this->counter().count(&TreeStats::removeCase1c);
+				NodeT* g = c->getRight();
 				rotateLeft(c);
 				rotateRight(n);
 				
@@ -583,11 +423,11 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int diff)
 				removeFix(p, nDiff);
 			}
 		} else if (diff == 1) { // n is right child 
-			AVLNode<Key, Value>* c = n->getRight();
+			NodeT* c = n->getRight();
 			if (c == NULL) return;
 			// case 1a  - zag zag 
 			if (c->getBalance() == 1) {
-				//rotateLeft(c);
+				this->counter().count(&TreeStats::removeCase1a);
 				rotateLeft(n);
 				n->setBalance(0);
 				c->setBalance(0);
@@ -595,7 +435,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int diff)
 			} 
 			// case 1b  - zag zag  
 			else if (c->getBalance() == 0) {
-				///rotateLeft(c);
+				this->counter().count(&TreeStats::removeCase1b);
 				rotateLeft(n);
 				n->setBalance(1);
 				c->setBalance(-1);
@@ -603,9 +443,8 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int diff)
 			}
 			// case 1c - zag zig  
 			else if (c->getBalance() == -1) {
-				AVLNode<Key, Value>* g = c->getLeft();
-				//rotateRight(g); 
-				//rotateLeft(c);
+				this->counter().count(&TreeStats::removeCase1c);
+				NodeT* g = c->getLeft();
 				rotateRight(c); 
 				rotateLeft(n);
 
@@ -629,20 +468,525 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int diff)
 
 }
 
-template<class Key, class Value>
-int AVLTree<Key, Value>::getHeight(AVLNode<Key, Value>* root) {
-	if (root == NULL) return -1;
+/**
+ * Number of nodes on the longest root to leaf path (0 when empty), in
+ * O(log n) by following the taller child at each level.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+int AVLTree<Key, Value, Compare, NodeT, Alloc>::height() const
+{
+	return spineHeight(this->root_);
+}
 
-	int lHeight = getHeight(root->getLeft());
-	int rHeight = getHeight(root->getRight());
+/**
+ * A height-bound check, not an invariant check: the root's stored balance
+ * factor is in [-1, 1] and the height is at most twice the length of a
+ * path down to a missing child.  That holds for every AVL tree, as
+ * siblings differ in height by at most one, and rules out degenerate
+ * chains.  Both paths follow the balance factors, so this is O(log n)
+ * and needs no size(), which costs O(n) after split().  Corrupted
+ * balance factors deeper down can pass; use validate() for the full
+ * O(n) check of the invariant.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool AVLTree<Key, Value, Compare, NodeT, Alloc>::isBalanced() const
+{
+	NodeT* root = this->root_;
+	if (root == NULL) return true;
+	if (root->getBalance() < -1 || root->getBalance() > 1) return false;
+	// down the shorter child at each level, the way spineHeight() does not
+	int shortest = 0;
+	for (NodeT* n = root; n != NULL; ++shortest) {
+		n = (n->getBalance() < 0) ? n->getRight() : n->getLeft();
+	}
+	return height() <= 2 * shortest;
+}
 
-	return std::max(lHeight, rHeight) + 1;
+/**
+ * The checks of BinarySearchTree::validate(), plus that every stored
+ * balance factor equals the real difference in subtree heights and lies
+ * in [-1, 1].  O(n); the heights are found bottom up with an explicit
+ * stack, so even a badly broken tree cannot overflow the call stack.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void AVLTree<Key, Value, Compare, NodeT, Alloc>::validate() const
+{
+	BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::validate();
+
+	// each entry is a node and the height of its left subtree, or -1
+	// while that subtree is still being measured
+	std::vector<std::pair<NodeT*, int> > path;
+	int height = 0;
+	for (NodeT* n = this->root_; n != NULL; n = n->getLeft()) {
+		path.push_back(std::make_pair(n, -1));
+	}
+	while (!path.empty()) {
+		std::pair<NodeT*, int>& top = path.back();
+		if (top.second < 0) {
+			top.second = height;
+			height = 0;
+			for (NodeT* n = top.first->getRight(); n != NULL; n = n->getLeft()) {
+				path.push_back(std::make_pair(n, -1));
+			}
+			continue;
+		}
+		int diff = height - top.second;
+		if (top.first->getBalance() != diff) throw std::logic_error("validate: stale balance factor");
+		if (diff < -1 || diff > 1) throw std::logic_error("validate: subtree out of balance");
+		height = 1 + std::max(height, top.second);
+		path.pop_back();
+	}
+}
+
+/**
+ * Splits the tree in O(log n): the first tree gets the keys less than key
+ * and the second the rest.  The nodes are relinked, not copied, and this
+ * tree is left empty.  Both trees share this tree's allocator.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+std::pair<AVLTree<Key, Value, Compare, NodeT, Alloc>, AVLTree<Key, Value, Compare, NodeT, Alloc> >
+AVLTree<Key, Value, Compare, NodeT, Alloc>::split(const Key& key)
+{
+	AVLTree left(this->comp_), right(this->comp_);
+	left.alloc_ = this->alloc_;
+	right.alloc_ = this->alloc_;
+
+	NodeT* root = this->root_;
+	NodeT* match;
+	int lHeight, rHeight;
+	// the joins below rotate through this->root_, so it is scratch space
+	splitHelper(root, spineHeight(root), key, left.root_, lHeight, match, right.root_, rHeight);
+	if (match != NULL) {
+		right.root_ = joinRoots(NULL, 0, match, right.root_, rHeight, rHeight);
+	}
+	this->root_ = NULL;
+	this->size_ = 0;
+	this->largest_ = NULL;
+	left.relinked();
+	right.relinked();
+	return std::make_pair(std::move(left), std::move(right));
+}
+
+/**
+ * Joins two trees in O(log n), where every key in left is less than every
+ * key in right, and returns the result; left and right are left empty.
+ * The nodes are relinked when the allocators compare equal (always so for
+ * std::allocator, or NodePools copied from one another, e.g. the halves of
+ * a split) and copied into left's allocator in O(m) otherwise.
+ * Throws std::invalid_argument if the keys are not in order.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>::join(AVLTree&& left, AVLTree&& right)
+{
+	if (left.empty()) return AVLTree(std::move(right));
+	if (right.empty()) return AVLTree(std::move(left));
+	NodeT* pivot = left.getLargestNode();
+	if (!left.keyLess(pivot->getKey(), right.getSmallestNode()->getKey())) {
+		throw std::invalid_argument("join: keys out of order");
+	}
+
+	AVLTree result(std::move(left));
+	std::size_t size = result.size_;
+	std::size_t rSize = right.size_;
+
+	NodeT* r = result.adopt(right);
+	int height;
+	result.root_ = result.joinPair(result.root_, spineHeight(result.root_), r, spineHeight(r), height);
+	result.relinked();
+	if (size != result.UNKNOWN_SIZE && rSize != result.UNKNOWN_SIZE) {
+		result.size_ = size + rSize;
+	}
+	return result;
+}
+
+/**
+ * Joins left, a new item and right in O(log n), where the keys in left are
+ * less than pivot's and the keys in right greater.  See join(left, right).
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>::join(AVLTree&& left, const std::pair<const Key, Value>& pivot, AVLTree&& right)
+{
+	if ((!left.empty() && !left.keyLess(left.getLargestNode()->getKey(), pivot.first)) ||
+		(!right.empty() && !left.keyLess(pivot.first, right.getSmallestNode()->getKey()))) {
+		throw std::invalid_argument("join: keys out of order");
+	}
+
+	AVLTree result(std::move(left));
+	std::size_t size = result.size_;
+	std::size_t rSize = right.size_;
+
+	NodeT* r = result.adopt(right);
+	NodeT* p = result.createNode(NULL, pivot.first, pivot.second);
+	int height;
+	result.root_ = result.joinRoots(result.root_, spineHeight(result.root_), p, r, spineHeight(r), height);
+	result.relinked();
+	if (size != result.UNKNOWN_SIZE && rSize != result.UNKNOWN_SIZE) {
+		result.size_ = size + rSize + 1;
+	}
+	return result;
+}
+
+/**
+ * Height of the subtree at root in O(log n): the AVL balance factors
+ * say which child is taller, so only one path needs to be followed.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+int AVLTree<Key, Value, Compare, NodeT, Alloc>::spineHeight(NodeT* root)
+{
+	int height = 0;
+	for (NodeT* n = root; n != NULL; ++height) {
+		n = (n->getBalance() < 0) ? n->getLeft() : n->getRight();
+	}
+	return height;
+}
+
+/**
+ * Splits the detached subtree at root, of the given height, into the keys
+ * less than key (left), the node with key itself if there is one (match,
+ * else NULL) and the keys greater (right), reporting both heights.
+ * Each level joins the subtree it keeps whole back on with the level's
+ * node as pivot; the joins cost O(difference in heights), which sums to
+ * O(log n) over the descent.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void AVLTree<Key, Value, Compare, NodeT, Alloc>::splitHelper(NodeT* root, int height, const Key& key,
+	NodeT*& left, int& lHeight, NodeT*& match, NodeT*& right, int& rHeight)
+{
+	if (root == NULL) {
+		left = right = match = NULL;
+		lHeight = rHeight = 0;
+		return;
+	}
+	this->counter().count(&TreeStats::nodesVisited);
+	NodeT* l = root->getLeft();
+	NodeT* r = root->getRight();
+	int lh = height - ((root->getBalance() == 1) ? 2 : 1);
+	int rh = height - ((root->getBalance() == -1) ? 2 : 1);
+	if (l != NULL) l->setParent(NULL);
+	if (r != NULL) r->setParent(NULL);
+
+	NodeT* mid;
+	int midHeight;
+	if (this->keyLess(root->getKey(), key)) {
+		// root and everything on its left stay left
+		splitHelper(r, rh, key, mid, midHeight, match, right, rHeight);
+		left = joinRoots(l, lh, root, mid, midHeight, lHeight);
+	} else if (this->keyLess(key, root->getKey())) {
+		splitHelper(l, lh, key, left, lHeight, match, mid, midHeight);
+		right = joinRoots(mid, midHeight, root, r, rh, rHeight);
+	} else {
+		left = l;
+		lHeight = lh;
+		right = r;
+		rHeight = rh;
+		match = root;
+		match->setLeft(NULL);
+		match->setRight(NULL);
+	}
+}
+
+/**
+ * Joins the detached subtrees left and right, of the given heights, with
+ * pivot between them and returns the new root and its height.  Trees of
+ * about equal height just become pivot's children.  Otherwise pivot takes
+ * the place of the first node down the taller tree's inner spine that is
+ * no more than one level taller than the shorter tree, and the retrace
+ * then rebalances exactly as after an insert, as that subtree grew by one.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* AVLTree<Key, Value, Compare, NodeT, Alloc>::joinRoots(NodeT* left, int lHeight,
+	NodeT* pivot, NodeT* right, int rHeight, int& height)
+{
+	pivot->setParent(NULL);
+	if (lHeight - rHeight <= 1 && rHeight - lHeight <= 1) {
+		pivot->setLeft(left);
+		pivot->setRight(right);
+		if (left != NULL) left->setParent(pivot);
+		if (right != NULL) right->setParent(pivot);
+		pivot->setBalance(rHeight - lHeight);
+		SubtreeSize<NodeT::TRACKS_SIZE>::update(pivot);
+		height = 1 + std::max(lHeight, rHeight);
+		return pivot;
+	}
+
+	bool leftTaller = lHeight > rHeight;
+	NodeT* top = leftTaller ? left : right;
+	int target = leftTaller ? rHeight : lHeight;
+	NodeT* g = NULL;
+	NodeT* c = top;
+	int h = leftTaller ? lHeight : rHeight;
+	while (h > target + 1) {
+		g = c;
+		if (leftTaller) {
+			h -= (c->getBalance() == -1) ? 2 : 1;
+			c = c->getRight();
+		} else {
+			h -= (c->getBalance() == 1) ? 2 : 1;
+			c = c->getLeft();
+		}
+	}
+	if (leftTaller) {
+		pivot->setLeft(c);
+		pivot->setRight(right);
+		if (right != NULL) right->setParent(pivot);
+		pivot->setBalance(target - h);
+		g->setRight(pivot);
+	} else {
+		pivot->setLeft(left);
+		pivot->setRight(c);
+		if (left != NULL) left->setParent(pivot);
+		pivot->setBalance(h - target);
+		g->setLeft(pivot);
+	}
+	if (c != NULL) c->setParent(pivot);
+	pivot->setParent(g);
+	top->setParent(NULL);
+
+	this->root_ = top;
+	SubtreeSize<NodeT::TRACKS_SIZE>::update(pivot);
+	SubtreeSize<NodeT::TRACKS_SIZE>::updatePath(g);
+	bool grew = insertFix(g, pivot);
+	height = (leftTaller ? lHeight : rHeight) + (grew ? 1 : 0);
+	return this->root_;
+}
+
+/**
+ * Joins the detached subtrees left and right, of the given heights, where
+ * every key in left is less than every key in right.  The largest node of
+ * left is taken out to serve as the pivot.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* AVLTree<Key, Value, Compare, NodeT, Alloc>::joinPair(NodeT* left, int lHeight,
+	NodeT* right, int rHeight, int& height)
+{
+	if (left == NULL) {
+		height = rHeight;
+		return right;
+	}
+	if (right == NULL) {
+		height = lHeight;
+		return left;
+	}
+	this->root_ = left;
+	NodeT* pivot = this->getLargestNode();
+	unlinkNode(pivot);
+	left = this->root_;
+	return joinRoots(left, spineHeight(left), pivot, right, rHeight, height);
+}
+
+/**
+ * Empties other and returns its root, ready to be linked into this tree.
+ * Nodes from an allocator that cannot free them here are copied into a
+ * balanced tree of this tree's nodes instead.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* AVLTree<Key, Value, Compare, NodeT, Alloc>::adopt(AVLTree& other)
+{
+	NodeT* root = other.root_;
+	if (root != NULL && this->alloc_ != other.alloc_) {
+		typename AVLTree::iterator it = other.begin();
+		int height;
+		root = this->buildBalanced(it, other.size(), NULL, height);
+		other.clear();
+		return root;
+	}
+	other.root_ = NULL;
+	other.size_ = 0;
+	other.largest_ = NULL;
+	return root;
+}
+
+/**
+ * Returns the keys in either tree, in O(m log(n/m + 1)) work for trees of
+ * sizes m <= n.  Recursion splits one tree at the other's root and works
+ * on the two halves in turn.  left and right are left empty;
+ * right's nodes are relinked as for join().  Compare must not throw.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>::setUnion(AVLTree&& left, AVLTree&& right)
+{
+	return setOperation(&AVLTree::unionRoots, std::move(left), std::move(right));
+}
+
+/**
+ * Returns the keys in both trees; see setUnion().
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>::setIntersection(AVLTree&& left, AVLTree&& right)
+{
+	return setOperation(&AVLTree::intersectRoots, std::move(left), std::move(right));
+}
+
+/**
+ * Returns the keys in left but not in right; see setUnion().
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>::setDifference(AVLTree&& left, AVLTree&& right)
+{
+	return setOperation(&AVLTree::differenceRoots, std::move(left), std::move(right));
+}
+
+/**
+ * Runs op over the roots of left and right.  The nodes op drops are only
+ * collected while it runs, and are counted and freed here afterwards.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>
+AVLTree<Key, Value, Compare, NodeT, Alloc>::setOperation(SetOp op, AVLTree&& left, AVLTree&& right)
+{
+	std::size_t size = (left.size_ == left.UNKNOWN_SIZE || right.size_ == right.UNKNOWN_SIZE)
+		? left.UNKNOWN_SIZE : left.size_ + right.size_;
+	AVLTree result(std::move(left));
+	NodeT* b = result.adopt(right);
+	NodeT* a = result.root_;
+	std::vector<NodeT*> garbage;
+	int height;
+	NodeT* root = (result.*op)(garbage, a, spineHeight(a), b, spineHeight(b), height);
+
+	result.root_ = root;
+	result.size_ = result.UNKNOWN_SIZE;
+	// what op dropped is counted as it is freed, so the result's size is
+	// known whenever both inputs' were
+	std::size_t dropped = 0;
+	for (std::size_t i = 0; i < garbage.size(); ++i) {
+		if (size != result.UNKNOWN_SIZE) dropped += result.countNodes(garbage[i]);
+		result.clearHelper(garbage[i]);
+	}
+	result.relinked();
+	if (size != result.UNKNOWN_SIZE && result.size_ == result.UNKNOWN_SIZE) {
+		result.size_ = size - dropped;
+	}
+	return result;
+}
+
+/**
+ * Union of the detached subtrees a and b: b is split at a's root, whose
+ * node is kept, and the halves are merged with a's subtrees.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* AVLTree<Key, Value, Compare, NodeT, Alloc>::unionRoots(std::vector<NodeT*>& garbage,
+	NodeT* a, int aHeight, NodeT* b, int bHeight, int& height)
+{
+	if (a == NULL) {
+		height = bHeight;
+		return b;
+	}
+	if (b == NULL) {
+		height = aHeight;
+		return a;
+	}
+	NodeT* al = a->getLeft();
+	NodeT* ar = a->getRight();
+	int alh = aHeight - ((a->getBalance() == 1) ? 2 : 1);
+	int arh = aHeight - ((a->getBalance() == -1) ? 2 : 1);
+	if (al != NULL) al->setParent(NULL);
+	if (ar != NULL) ar->setParent(NULL);
+
+	NodeT* bl;
+	NodeT* match;
+	NodeT* br;
+	int blh, brh;
+	splitHelper(b, bHeight, a->getKey(), bl, blh, match, br, brh);
+	if (match != NULL) garbage.push_back(match);
+
+	NodeT* l;
+	NodeT* r;
+	int lh, rh;
+	l = unionRoots(garbage, al, alh, bl, blh, lh);
+	r = unionRoots(garbage, ar, arh, br, brh, rh);
+	return joinRoots(l, lh, a, r, rh, height);
+}
+
+/**
+ * Intersection of the detached subtrees a and b: a's root is kept only
+ * if splitting b at it finds the same key.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* AVLTree<Key, Value, Compare, NodeT, Alloc>::intersectRoots(std::vector<NodeT*>& garbage,
+	NodeT* a, int aHeight, NodeT* b, int bHeight, int& height)
+{
+	if (a == NULL || b == NULL) {
+		if (a != NULL) garbage.push_back(a);
+		if (b != NULL) garbage.push_back(b);
+		height = 0;
+		return NULL;
+	}
+	NodeT* al = a->getLeft();
+	NodeT* ar = a->getRight();
+	int alh = aHeight - ((a->getBalance() == 1) ? 2 : 1);
+	int arh = aHeight - ((a->getBalance() == -1) ? 2 : 1);
+	if (al != NULL) al->setParent(NULL);
+	if (ar != NULL) ar->setParent(NULL);
+
+	NodeT* bl;
+	NodeT* match;
+	NodeT* br;
+	int blh, brh;
+	splitHelper(b, bHeight, a->getKey(), bl, blh, match, br, brh);
+
+	NodeT* l;
+	NodeT* r;
+	int lh, rh;
+	l = intersectRoots(garbage, al, alh, bl, blh, lh);
+	r = intersectRoots(garbage, ar, arh, br, brh, rh);
+	if (match != NULL) {
+		garbage.push_back(match);
+		return joinRoots(l, lh, a, r, rh, height);
+	}
+	a->setLeft(NULL);
+	a->setRight(NULL);
+	garbage.push_back(a);
+	return joinPair(l, lh, r, rh, height);
+}
+
+/**
+ * Difference of the detached subtrees a and b: a is split at b's root,
+ * which drops the node with that key from a, and b's halves are taken
+ * from a's halves.
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* AVLTree<Key, Value, Compare, NodeT, Alloc>::differenceRoots(std::vector<NodeT*>& garbage,
+	NodeT* a, int aHeight, NodeT* b, int bHeight, int& height)
+{
+	if (a == NULL || b == NULL) {
+		if (b != NULL) garbage.push_back(b);
+		height = aHeight;
+		return a;
+	}
+	NodeT* bl = b->getLeft();
+	NodeT* br = b->getRight();
+	int blh = bHeight - ((b->getBalance() == 1) ? 2 : 1);
+	int brh = bHeight - ((b->getBalance() == -1) ? 2 : 1);
+	if (bl != NULL) bl->setParent(NULL);
+	if (br != NULL) br->setParent(NULL);
+	b->setLeft(NULL);
+	b->setRight(NULL);
+	garbage.push_back(b);
+
+	NodeT* al;
+	NodeT* match;
+	NodeT* ar;
+	int alh, arh;
+	splitHelper(a, aHeight, b->getKey(), al, alh, match, ar, arh);
+	if (match != NULL) garbage.push_back(match);
+
+	NodeT* l;
+	NodeT* r;
+	int lh, rh;
+	l = differenceRoots(garbage, al, alh, bl, blh, lh);
+	r = differenceRoots(garbage, ar, arh, br, brh, rh);
+	return joinPair(l, lh, r, rh, height);
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void AVLTree<Key, Value, Compare, NodeT, Alloc>::nodeSwap( NodeT* n1, NodeT* n2)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::nodeSwap(n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
@@ -0,0 +1,1534 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "bst.h"
+#include "avlbst.h"
+#include "splaybst.h"
+#include "compact_avl.h"
+#include "btree.h"
+#include "concurrent_avl.h"
+#include "persistent_avl.h"
+#include "frozen_tree.h"
+#include "tree_snapshot.h"
+
+using namespace std;
+
+typedef uint64_t BenchKey;
+
+// Seconds elapsed on a monotonic clock
+static double now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static vector<BenchKey> randomKeys(size_t n, unsigned seed)
+{
+    mt19937_64 rng(seed);
+    vector<BenchKey> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = rng();
+    }
+    return keys;
+}
+
+static void printHeader(const char* title)
+{
+    cout << "\n" << title << "\n";
+    cout << left << setw(28) << "tree" << right
+         << setw(14) << "insert Mop/s" << setw(14) << "clear Mop/s" << "\n";
+}
+
+static void printRow(const string& name, size_t ops, double insertSec, double clearSec)
+{
+    cout << left << setw(28) << name << right << fixed << setprecision(2)
+         << setw(14) << ops / insertSec / 1e6
+         << setw(14) << ops / clearSec / 1e6 << "\n";
+}
+
+/**
+ * Fills the tree from keys and clears it again, rounds times,
+ * reporting insert and clear throughput.
+ */
+template<typename Tree>
+void insertClear(const string& name, const vector<BenchKey>& keys, int rounds)
+{
+    Tree tree;
+    double insertSec = 0, clearSec = 0;
+    for(int r = 0; r < rounds; ++r) {
+        double t0 = now();
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        double t1 = now();
+        tree.clear();
+        double t2 = now();
+        insertSec += t1 - t0;
+        clearSec += t2 - t1;
+    }
+    printRow(name, keys.size() * rounds, insertSec, clearSec);
+}
+
+/**
+ * NodePool against one new/delete per node (std::allocator).
+ */
+void benchPool(size_t n)
+{
+    typedef Node<BenchKey, BenchKey> BNode;
+    typedef AVLNode<BenchKey, BenchKey> ANode;
+    vector<BenchKey> keys = randomKeys(n, 1);
+    printHeader("node allocation, random keys");
+    insertClear<BinarySearchTree<BenchKey, BenchKey, less<BenchKey>, BNode, allocator<BNode> > >("BST new/delete", keys, 3);
+    insertClear<BinarySearchTree<BenchKey, BenchKey, less<BenchKey>, BNode> >("BST NodePool", keys, 3);
+    insertClear<AVLTree<BenchKey, BenchKey, less<BenchKey>, ANode, allocator<ANode> > >("AVL new/delete", keys, 3);
+    insertClear<AVLTree<BenchKey, BenchKey> >("AVL NodePool", keys, 3);
+}
+
+/**
+ * An AVLNode that counts the link and balance stores made through it.
+ */
+template<typename Key, typename Value>
+class CountingNode : public AVLNode<Key, Value>
+{
+public:
+    template<typename... Args>
+    CountingNode(CountingNode<Key, Value>* parent, Args&&... args) :
+        AVLNode<Key, Value>(parent, std::forward<Args>(args)...) { }
+
+    CountingNode<Key, Value>* getParent() const { return static_cast<CountingNode<Key, Value>*>(this->parent_); }
+    CountingNode<Key, Value>* getLeft() const { return static_cast<CountingNode<Key, Value>*>(this->left_); }
+    CountingNode<Key, Value>* getRight() const { return static_cast<CountingNode<Key, Value>*>(this->right_); }
+
+    void setParent(Node<Key, Value>* parent) { ++writes; this->parent_ = parent; }
+    void setLeft(Node<Key, Value>* left) { ++writes; this->left_ = left; }
+    void setRight(Node<Key, Value>* right) { ++writes; this->right_ = right; }
+    void setBalance(int8_t balance) { ++writes; this->balance_ = balance; }
+
+    static size_t writes;
+};
+
+template<typename Key, typename Value>
+size_t CountingNode<Key, Value>::writes = 0;
+
+typedef CountingNode<BenchKey, BenchKey> CNode;
+
+/**
+ * The previous AVLTree::insert, kept as a baseline: it recurses to the
+ * leaf, relinks every ancestor on the way back up and then recurses
+ * again in insertFix.
+ */
+class RecursiveAVLTree : public AVLTree<BenchKey, BenchKey, less<BenchKey>, CNode>
+{
+public:
+    virtual void insert(const pair<const BenchKey, BenchKey>& item)
+    {
+        CNode* added = NULL;
+        root_ = insertHelper(root_, item, NULL, added);
+        CNode* p = added->getParent();
+        if(p != NULL) {
+            if(abs(p->getBalance()) == 1) {
+                p->setBalance(0);
+            } else {
+                p->setBalance(p->getLeft() == added ? -1 : 1);
+                recursiveFix(p, added);
+            }
+        }
+    }
+
+private:
+    CNode* insertHelper(CNode* root, const pair<const BenchKey, BenchKey>& item, CNode* parent, CNode*& added)
+    {
+        if(root == NULL) {
+            return added = createNode(parent, item.first, item.second);
+        }
+        if(root->getKey() == item.first) {
+            root->setValue(item.second);
+            added = root;
+        } else if(item.first < root->getKey()) {
+            root->setLeft(insertHelper(root->getLeft(), item, root, added));
+            root->getLeft()->setParent(root);
+        } else {
+            root->setRight(insertHelper(root->getRight(), item, root, added));
+            root->getRight()->setParent(root);
+        }
+        return root;
+    }
+
+    void recursiveFix(CNode* p, CNode* n)
+    {
+        if(p == NULL || p->getParent() == NULL) return;
+        CNode* g = p->getParent();
+        int isLeft = (g->getLeft() == p) ? 1 : -1;
+        g->setBalance(g->getBalance() - isLeft);
+        if(g->getBalance() == 0) return;
+        if(g->getBalance() == -isLeft) {
+            recursiveFix(g, p);
+            return;
+        }
+        bool zigzig = (isLeft == 1) ? (p->getLeft() == n) : (p->getRight() == n);
+        if(isLeft == 1) {
+            if(!zigzig) rotateLeft(p);
+            rotateRight(g);
+        } else {
+            if(!zigzig) rotateRight(p);
+            rotateLeft(g);
+        }
+        if(zigzig) {
+            p->setBalance(0);
+            g->setBalance(0);
+        } else {
+            int8_t nb = n->getBalance();
+            p->setBalance(nb == isLeft ? -isLeft : 0);
+            g->setBalance(nb == -isLeft ? isLeft : 0);
+            n->setBalance(0);
+        }
+    }
+};
+
+template<typename Tree>
+void insertWrites(const string& name, const vector<BenchKey>& keys)
+{
+    Tree tree;
+    CNode::writes = 0;
+    double t0 = now();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    double t1 = now();
+    cout << left << setw(28) << name << right << fixed << setprecision(2)
+         << setw(14) << (t1 - t0) * 1e9 / keys.size()
+         << setw(14) << double(CNode::writes) / keys.size() << "\n";
+}
+
+/**
+ * Iterative single-pass AVL insert against the recursive rebuild.
+ */
+void benchAvlInsert(size_t n)
+{
+    vector<BenchKey> keys = randomKeys(n, 2);
+    vector<BenchKey> sorted(keys);
+    sort(sorted.begin(), sorted.end());
+    cout << "\nAVL insert" << "\n";
+    cout << left << setw(28) << "tree" << right
+         << setw(14) << "ns/insert" << setw(14) << "writes/insert" << "\n";
+    insertWrites<RecursiveAVLTree>("recursive, random keys", keys);
+    insertWrites<AVLTree<BenchKey, BenchKey, less<BenchKey>, CNode> >("iterative, random keys", keys);
+    insertWrites<RecursiveAVLTree>("recursive, sorted keys", sorted);
+    insertWrites<AVLTree<BenchKey, BenchKey, less<BenchKey>, CNode> >("iterative, sorted keys", sorted);
+}
+
+/**
+ * select()/rank() on a SizedNode tree against walking the iterator.
+ */
+void benchOrderStatistics(size_t n)
+{
+    typedef AVLTree<BenchKey, BenchKey, less<BenchKey>, SizedNode<AVLNode<BenchKey, BenchKey> > > SizedTree;
+    vector<BenchKey> keys = randomKeys(n, 3);
+    SizedTree tree;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    mt19937_64 rng(4);
+    const size_t queries = 200;
+    vector<size_t> ranks(queries);
+    for(size_t q = 0; q < queries; ++q) {
+        ranks[q] = rng() % tree.size();
+    }
+
+    BenchKey sink = 0;
+    double t0 = now();
+    for(size_t q = 0; q < queries; ++q) {
+        sink += tree.select(ranks[q])->first;
+    }
+    double t1 = now();
+    for(size_t q = 0; q < queries; ++q) {
+        SizedTree::iterator it = tree.begin();
+        for(size_t i = 0; i < ranks[q]; ++i) ++it;
+        sink += it->first;
+    }
+    double t2 = now();
+    for(size_t q = 0; q < queries; ++q) {
+        sink += tree.rank(keys[ranks[q]]);
+    }
+    double t3 = now();
+    for(size_t q = 0; q < queries; ++q) {
+        size_t below = 0;
+        for(SizedTree::iterator it = tree.begin(); it != tree.end() && it->first < keys[ranks[q]]; ++it) ++below;
+        sink += below;
+    }
+    double t4 = now();
+
+    cout << "\norder statistics, " << tree.size() << " keys (checksum " << sink % 1000 << ")\n";
+    cout << left << setw(28) << "query" << right << setw(14) << "ns/query" << "\n";
+    cout << fixed << setprecision(0);
+    cout << left << setw(28) << "select(k)" << right << setw(14) << (t1 - t0) * 1e9 / queries << "\n";
+    cout << left << setw(28) << "k-th by iteration" << right << setw(14) << (t2 - t1) * 1e9 / queries << "\n";
+    cout << left << setw(28) << "rank(key)" << right << setw(14) << (t3 - t2) * 1e9 / queries << "\n";
+    cout << left << setw(28) << "rank by iteration" << right << setw(14) << (t4 - t3) * 1e9 / queries << "\n";
+}
+
+/**
+ * A transparent string ordering that counts its calls.
+ */
+struct CountingLess {
+    typedef void is_transparent;
+    static size_t calls;
+    template<typename A, typename B>
+    bool operator()(const A& a, const B& b) const { ++calls; return string_view(a) < string_view(b); }
+};
+
+size_t CountingLess::calls = 0;
+
+template<typename Tree, typename Probe>
+void stringLookups(const string& name, const Tree& tree, const vector<Probe>& probes)
+{
+    CountingLess::calls = 0;
+    size_t hits = 0;
+    double t0 = now();
+    for(size_t i = 0; i < probes.size(); ++i) {
+        hits += tree.find(probes[i]) != tree.end();
+    }
+    double t1 = now();
+    cout << left << setw(28) << name << right << fixed << setprecision(2)
+         << setw(14) << (t1 - t0) * 1e9 / probes.size()
+         << setw(14) << double(CountingLess::calls) / probes.size()
+         << setw(10) << hits << "\n";
+}
+
+/**
+ * Key comparisons per lookup with long string keys sharing a prefix,
+ * against std::map, and by string_view without building a std::string.
+ */
+void benchCompare(size_t n)
+{
+    vector<BenchKey> raw = randomKeys(n, 5);
+    vector<string> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = "/usr/share/dictionary/" + to_string(raw[i]);
+    }
+    AVLTree<string, BenchKey, CountingLess> tree;
+    map<string, BenchKey, CountingLess> stdMap;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], raw[i]));
+        stdMap.insert(make_pair(keys[i], raw[i]));
+    }
+    vector<string> probes(keys);
+    shuffle(probes.begin(), probes.end(), mt19937_64(6));
+    vector<string_view> views(probes.begin(), probes.end());
+
+    cout << "\nstring lookups, " << n << " keys, log2(n) = " << fixed << setprecision(1) << log2(double(n)) << "\n";
+    cout << left << setw(28) << "lookup" << right
+         << setw(14) << "ns/find" << setw(14) << "compares/find" << setw(10) << "hits" << "\n";
+    stringLookups("AVLTree find(string)", tree, probes);
+    stringLookups("AVLTree find(string_view)", tree, views);
+    stringLookups("std::map find(string)", stdMap, probes);
+}
+
+/**
+ * split() at a key and join() back, against moving the same items
+ * between trees one insert at a time.
+ */
+void benchSplitJoin(size_t n)
+{
+    typedef AVLTree<BenchKey, BenchKey> Tree;
+    vector<BenchKey> keys = randomKeys(n, 7);
+    vector<BenchKey> sorted(keys);
+    sort(sorted.begin(), sorted.end());
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+
+    mt19937_64 rng(8);
+    const size_t rounds = 1000;
+    double t0 = now();
+    for(size_t r = 0; r < rounds; ++r) {
+        pair<Tree, Tree> parts = tree.split(sorted[rng() % n]);
+        tree = Tree::join(move(parts.first), move(parts.second));
+    }
+    double t1 = now();
+    // the same partition by reinsertion, once
+    BenchKey pivot = sorted[n / 2];
+    Tree below, above;
+    for(Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        if(it->first < pivot) below.insert(*it);
+        else above.insert(*it);
+    }
+    for(Tree::iterator it = above.begin(); it != above.end(); ++it) {
+        below.insert(*it);
+    }
+    double t2 = now();
+
+    cout << "\nsplit + join, " << tree.size() << " keys\n";
+    cout << left << setw(28) << "method" << right << setw(14) << "us/round" << "\n";
+    cout << fixed << setprecision(2);
+    cout << left << setw(28) << "split + join" << right << setw(14) << (t1 - t0) * 1e6 / rounds << "\n";
+    cout << left << setw(28) << "reinsertion" << right << setw(14) << (t2 - t1) * 1e6 << "\n";
+}
+
+typedef AVLTree<BenchKey, BenchKey> SetTree;
+
+/**
+ * A tree bulk loaded from n distinct random keys below range.
+ */
+static SetTree randomSet(size_t n, BenchKey range, unsigned seed)
+{
+    vector<BenchKey> keys = randomKeys(n, seed);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] %= range;
+    }
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<pair<BenchKey, BenchKey> > items;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        items.push_back(make_pair(keys[i], keys[i]));
+    }
+    return SetTree(items.begin(), items.end());
+}
+
+/**
+ * Join-based union, intersection and difference of two overlapping sets
+ * of n keys, against a loop of inserts merging the same two sets.
+ */
+void benchSetOps(size_t n)
+{
+    typedef SetTree (*SetOp)(SetTree&&, SetTree&&);
+    const char* names[] = { "union", "intersection", "difference" };
+    SetOp ops[] = { &SetTree::setUnion, &SetTree::setIntersection, &SetTree::setDifference };
+
+    cout << "\nset operations, 2 x " << n << " keys\n";
+    cout << left << setw(28) << "operation" << right << setw(14) << "ms" << "\n";
+    cout << fixed << setprecision(2);
+    {
+        SetTree a = randomSet(n, 2 * n, 9);
+        SetTree b = randomSet(n, 2 * n, 10);
+        double t0 = now();
+        for(SetTree::iterator it = b.begin(); it != b.end(); ++it) {
+            a.insert(*it);
+        }
+        double t1 = now();
+        cout << left << setw(28) << "union by insert loop" << right << setw(14) << (t1 - t0) * 1e3 << "\n";
+    }
+    for(size_t op = 0; op < 3; ++op) {
+        SetTree a = randomSet(n, 2 * n, 9);
+        SetTree b = randomSet(n, 2 * n, 10);
+        double t0 = now();
+        SetTree result = ops[op](move(a), move(b));
+        double t1 = now();
+        cout << left << setw(28) << names[op] << right << setw(14) << (t1 - t0) * 1e3 << "\n";
+    }
+}
+
+/**
+ * A full in-order walk with the parent-climbing iterator, the same walk
+ * backwards, and the stack-based cursor, at n and 10n keys inserted in
+ * random order; then the cost per call of starting a reverse scan.
+ */
+void benchIterate(size_t n)
+{
+    typedef AVLTree<BenchKey, BenchKey> Tree;
+    cout << "\nfull iteration\n";
+    cout << left << setw(28) << "walk" << right << setw(10) << "keys" << setw(14) << "ns/item" << "\n";
+    cout << fixed << setprecision(2);
+    const size_t sizes[] = { n, 10 * n };
+    for(size_t s = 0; s < 2; ++s) {
+        vector<BenchKey> keys = randomKeys(sizes[s], 19);
+        Tree tree;
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        BenchKey sum = 0, backward = 0;
+        double t0 = now();
+        for(Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sum += it->second;
+        }
+        double t1 = now();
+        for(Tree::cursor it = tree.inorder().begin(); it != tree.inorder().end(); ++it) {
+            sum -= it->second;
+        }
+        double t2 = now();
+        for(Tree::reverse_iterator it = tree.rbegin(); it != tree.rend(); ++it) {
+            backward += it->second;
+        }
+        double t3 = now();
+        BenchKey largest = tree.rbegin()->first;
+        for(size_t i = 0; i < keys.size(); ++i) {
+            sum += tree.rbegin()->first - largest;
+        }
+        double t4 = now();
+        for(size_t i = 0; i < keys.size(); ++i) {
+            backward -= keys[i];
+        }
+        if(sum != 0 || backward != 0) cerr << "walk mismatch\n";
+        cout << left << setw(28) << "iterator" << right << setw(10) << keys.size()
+             << setw(14) << (t1 - t0) * 1e9 / keys.size() << "\n";
+        cout << left << setw(28) << "cursor" << right << setw(10) << keys.size()
+             << setw(14) << (t2 - t1) * 1e9 / keys.size() << "\n";
+        cout << left << setw(28) << "reverse iterator" << right << setw(10) << keys.size()
+             << setw(14) << (t3 - t2) * 1e9 / keys.size() << "\n";
+        cout << left << setw(28) << "rbegin" << right << setw(10) << keys.size()
+             << setw(14) << (t4 - t3) * 1e9 / keys.size() << "\n";
+    }
+}
+
+/**
+ * Resident set size of the process in bytes, read from /proc/self/statm;
+ * 0 where that is not available.
+ */
+size_t residentBytes()
+{
+    size_t pages = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if(statm == NULL) return 0;
+    if(fscanf(statm, "%zu %zu", &pages, &resident) != 2) resident = 0;
+    fclose(statm);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Bytes per element, measured as the growth in resident memory while the
+ * tree is filled, next to sizeof the node, and insert and find
+ * throughput.  Each node type is measured once, on a fresh allocator.
+ */
+template<typename Tree, typename Key>
+void nodeFootprint(const string& name, size_t nodeBytes, const vector<Key>& keys)
+{
+    Tree tree;
+#ifdef __GLIBC__
+    // hand back what earlier trees freed, or reusing it would not show up
+    malloc_trim(0);
+#endif
+    size_t before = residentBytes();
+    double t0 = now();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    double t1 = now();
+    size_t after = residentBytes();
+    Key sum = 0;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        sum += tree.find(keys[i])->second;
+    }
+    double t2 = now();
+    if(sum == 1) cerr << "unlikely\n";
+    cout << left << setw(28) << name << right << fixed << setprecision(2)
+         << setw(10) << tree.size() << setw(14) << double(after - before) / tree.size() << setw(14) << nodeBytes
+         << setw(14) << keys.size() / (t1 - t0) / 1e6 << setw(14) << keys.size() / (t2 - t1) / 1e6 << "\n";
+}
+
+template<typename Key>
+void compactFootprint(const string& name, size_t n)
+{
+    vector<BenchKey> raw = randomKeys(n, 18);
+    vector<Key> keys(raw.begin(), raw.end());
+    nodeFootprint<AVLTree<Key, Key>, Key>(name + " AVLNode", sizeof(AVLNode<Key, Key>), keys);
+    nodeFootprint<CompactAVLTree<Key, Key>, Key>(name + " CompactAVLNode",
+                                                 sizeof(CompactAVLNode<Key, Key>), keys);
+}
+
+void benchCompact(size_t n)
+{
+    cout << "\ncompact nodes\n";
+    cout << left << setw(28) << "tree" << right << setw(10) << "keys" << setw(14) << "RSS B/elem"
+         << setw(14) << "sizeof node" << setw(14) << "insert Mop/s" << setw(14) << "find Mop/s" << "\n";
+    compactFootprint<uint16_t>("uint16_t", n);
+    compactFootprint<uint32_t>("uint32_t", n);
+    compactFootprint<uint64_t>("uint64_t", n);
+}
+
+/**
+ * Lookups and a full walk of a frozen copy against the AVLTree it was
+ * frozen from, with 64 bit keys and with 16 bit keys.
+ */
+template<typename Key>
+void frozenLookups(const string& name, size_t n)
+{
+    vector<BenchKey> raw = randomKeys(n, 16);
+    AVLTree<Key, Key> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(Key(raw[i]), Key(raw[i])));
+    }
+    FrozenTree<Key, Key> frozen = tree.freeze();
+    vector<Key> probes(4 * n);
+    mt19937_64 rng(17);
+    for(size_t i = 0; i < probes.size(); ++i) {
+        probes[i] = Key(raw[rng() % n]);
+    }
+
+    Key sum = 0;
+    double t0 = now();
+    for(size_t i = 0; i < probes.size(); ++i) {
+        sum += tree.find(probes[i])->second;
+    }
+    double t1 = now();
+    for(size_t i = 0; i < probes.size(); ++i) {
+        sum -= frozen.find(probes[i])->second;
+    }
+    double t2 = now();
+    for(typename AVLTree<Key, Key>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        sum += it->second;
+    }
+    double t3 = now();
+    for(typename FrozenTree<Key, Key>::iterator it = frozen.begin(); it != frozen.end(); ++it) {
+        sum -= it->second;
+    }
+    double t4 = now();
+    if(sum != 0) cerr << "lookup mismatch\n";
+    cout << left << setw(28) << name + " AVLTree" << right << fixed << setprecision(2)
+         << setw(10) << tree.size() << setw(14) << probes.size() / (t1 - t0) / 1e6
+         << setw(14) << tree.size() / (t3 - t2) / 1e6 << "\n";
+    cout << left << setw(28) << name + " FrozenTree" << right
+         << setw(10) << frozen.size() << setw(14) << probes.size() / (t2 - t1) / 1e6
+         << setw(14) << frozen.size() / (t4 - t3) / 1e6 << "\n";
+}
+
+void benchFrozen(size_t n)
+{
+    cout << "\nfrozen trees\n";
+    cout << left << setw(28) << "tree" << right << setw(10) << "keys"
+         << setw(14) << "find Mop/s" << setw(14) << "walk Mop/s" << "\n";
+    frozenLookups<BenchKey>("uint64_t", n);
+    frozenLookups<uint16_t>("uint16_t", n);
+}
+
+/**
+ * Builds a Tree from keys, then times a lookup of every key in a
+ * shuffled order and a full in-order walk.
+ */
+template<typename Tree>
+void insertFindWalk(const string& name, const vector<BenchKey>& keys)
+{
+    vector<BenchKey> probes(keys);
+    shuffle(probes.begin(), probes.end(), mt19937_64(14));
+    Tree tree;
+    double t0 = now();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    double t1 = now();
+    BenchKey sum = 0;
+    for(size_t i = 0; i < probes.size(); ++i) {
+        sum += tree.find(probes[i])->second;
+    }
+    double t2 = now();
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        sum -= it->second;
+    }
+    double t3 = now();
+    if(sum != 0) cerr << "lookup mismatch\n";
+    size_t n = keys.size();
+    cout << left << setw(28) << name << right << fixed << setprecision(2)
+         << setw(14) << n / (t1 - t0) / 1e6 << setw(14) << n / (t2 - t1) / 1e6
+         << setw(14) << n / (t3 - t2) / 1e6 << "\n";
+}
+
+/**
+ * BTree against AVLTree and std::map, with keys inserted in random and
+ * in ascending order.
+ */
+void benchBTree(size_t n)
+{
+    vector<BenchKey> keys = randomKeys(n, 15);
+    for(int sorted = 0; sorted < 2; ++sorted) {
+        if(sorted) sort(keys.begin(), keys.end());
+        cout << "\n" << (sorted ? "sequential" : "random") << " keys, " << n << "\n";
+        cout << left << setw(28) << "tree" << right << setw(14) << "insert Mop/s"
+             << setw(14) << "find Mop/s" << setw(14) << "walk Mop/s" << "\n";
+        insertFindWalk<BTree<BenchKey, BenchKey> >("BTree", keys);
+        insertFindWalk<AVLTree<BenchKey, BenchKey> >("AVLTree", keys);
+        insertFindWalk<map<BenchKey, BenchKey> >("std::map", keys);
+    }
+}
+
+/**
+ * The single external mutex ConcurrentAVLTree replaces, with the same
+ * calls, as the baseline for benchConcurrent.
+ */
+struct LockedAVLTree {
+    AVLTree<BenchKey, BenchKey> tree;
+    mutable mutex lock;
+
+    bool find(BenchKey key, BenchKey& value) const
+    {
+        lock_guard<mutex> guard(lock);
+        AVLTree<BenchKey, BenchKey>::const_iterator it = tree.find(key);
+        if(it == tree.end()) return false;
+        value = it->second;
+        return true;
+    }
+    void insert(const pair<const BenchKey, BenchKey>& item)
+    {
+        lock_guard<mutex> guard(lock);
+        tree.insert(item);
+    }
+    bool remove(BenchKey key)
+    {
+        lock_guard<mutex> guard(lock);
+        tree.remove(key);
+        return true;
+    }
+};
+
+/**
+ * Runs ops operations split over threads, writePercent of them a remove
+ * and reinsert of a random key and the rest lookups.  Returns Mop/s.
+ */
+template<typename Map>
+double mixedOps(Map& map, const vector<BenchKey>& keys, size_t threads, unsigned writePercent, size_t ops)
+{
+    vector<thread> workers;
+    double t0 = now();
+    for(size_t t = 0; t < threads; ++t) {
+        workers.push_back(thread([&, t]() {
+            mt19937_64 rng(200 + t);
+            BenchKey value = 0;
+            for(size_t i = 0; i < ops / threads; ++i) {
+                BenchKey key = keys[rng() % keys.size()];
+                if(rng() % 100 < writePercent) {
+                    map.remove(key);
+                    map.insert(make_pair(key, key));
+                } else {
+                    map.find(key, value);
+                }
+            }
+            if(value == 1) cerr << "unlikely\n";
+        }));
+    }
+    for(size_t t = 0; t < threads; ++t) {
+        workers[t].join();
+    }
+    return ops / (now() - t0) / 1e6;
+}
+
+/**
+ * ConcurrentAVLTree (optimistic finds, striped write locks) against an
+ * AVLTree behind one mutex, at 99/1, 90/10 and 50/50 read/write mixes
+ * on 1, 2, 4 and 8 threads.
+ */
+void benchConcurrent(size_t n)
+{
+    vector<BenchKey> keys = randomKeys(n, 13);
+    ConcurrentAVLTree<BenchKey, BenchKey> shared;
+    LockedAVLTree locked;
+    for(size_t i = 0; i < n; ++i) {
+        shared.insert(make_pair(keys[i], keys[i]));
+        locked.insert(make_pair(keys[i], keys[i]));
+    }
+
+    const unsigned writePercents[] = { 1, 10, 50 };
+    const size_t threadCounts[] = { 1, 2, 4, 8 };
+    const size_t ops = 1000000;
+    cout << "\nconcurrent map, " << n << " keys (" << thread::hardware_concurrency() << " hardware threads)\n";
+    cout << left << setw(28) << "read/write" << right << setw(10) << "threads"
+         << setw(14) << "striped Mop/s" << setw(14) << "mutex Mop/s" << "\n";
+    cout << fixed << setprecision(2);
+    for(size_t w = 0; w < 3; ++w) {
+        for(size_t t = 0; t < 4; ++t) {
+            double rw = mixedOps(shared, keys, threadCounts[t], writePercents[w], ops);
+            double mx = mixedOps(locked, keys, threadCounts[t], writePercents[w], ops);
+            cout << left << setw(28) << to_string(100 - writePercents[w]) + "/" + to_string(writePercents[w])
+                 << right << setw(10) << threadCounts[t] << setw(14) << rw << setw(14) << mx << "\n";
+        }
+    }
+}
+
+/**
+ * Lookup throughput of readers working on snapshots of a persistent
+ * tree, with and without a writer inserting and removing keys meanwhile.
+ * Each reader takes a fresh snapshot every 1000 lookups.
+ */
+void benchSnapshots(size_t n)
+{
+    typedef PersistentAVLTree<BenchKey, BenchKey> Tree;
+    vector<BenchKey> keys = randomKeys(n, 11);
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+
+    const double seconds = 0.5;
+    const size_t readerCounts[] = { 1, 2, 4 };
+    cout << "\nsnapshot readers, " << n << " keys (" << thread::hardware_concurrency() << " hardware threads)\n";
+    cout << left << setw(28) << "readers" << right
+         << setw(10) << "writer" << setw(14) << "read Mop/s" << setw(14) << "write Kop/s" << "\n";
+    cout << fixed << setprecision(2);
+    for(size_t r = 0; r < 3; ++r) {
+        for(int writing = 0; writing < 2; ++writing) {
+            atomic<bool> stop(false);
+            atomic<size_t> reads(0);
+            size_t writes = 0;
+            vector<thread> readers;
+            for(size_t t = 0; t < readerCounts[r]; ++t) {
+                readers.push_back(thread([&, t]() {
+                    mt19937_64 rng(100 + t);
+                    size_t found = 0, done = 0;
+                    while(!stop.load(memory_order_relaxed)) {
+                        Tree::Snapshot snap = tree.snapshot();
+                        for(int i = 0; i < 1000; ++i) {
+                            found += snap.find(keys[rng() % n]) != NULL;
+                        }
+                        done += 1000;
+                    }
+                    reads += done;
+                    if(found > done) cerr << "impossible\n";
+                }));
+            }
+            double t0 = now();
+            if(writing) {
+                // replace keys with fresh ones, keeping the size steady
+                mt19937_64 rng(12);
+                while(now() - t0 < seconds) {
+                    BenchKey key = keys[rng() % n];
+                    tree.remove(key);
+                    tree.insert(make_pair(key, key + 1));
+                    writes += 2;
+                }
+            } else {
+                this_thread::sleep_for(chrono::duration<double>(seconds));
+            }
+            stop = true;
+            for(size_t t = 0; t < readers.size(); ++t) {
+                readers[t].join();
+            }
+            double t1 = now();
+            cout << left << setw(28) << readerCounts[r] << right
+                 << setw(10) << (writing ? "yes" : "no")
+                 << setw(14) << reads / (t1 - t0) / 1e6
+                 << setw(14) << writes / (t1 - t0) / 1e3 << "\n";
+        }
+    }
+}
+
+/**
+ * Restart cost: rebuilding a tree by reinserting every key against
+ * loading a saved snapshot, and against mapping it for lookups in place.
+ * The snapshot was just written, so its pages are in the page cache.
+ */
+void benchStartup(size_t n)
+{
+    typedef AVLTree<BenchKey, BenchKey> Tree;
+    const string path = "bst-bench.snapshot";
+    vector<BenchKey> keys = randomKeys(n, 23);
+    vector<BenchKey> probes(keys);
+    shuffle(probes.begin(), probes.end(), mt19937_64(24));
+
+    cout << "\nstartup, " << n << " keys\n";
+    cout << left << setw(28) << "step" << right << setw(14) << "ms" << setw(14) << "find Mop/s" << "\n";
+    cout << fixed << setprecision(2);
+
+    double t0 = now();
+    Tree built;
+    for(size_t i = 0; i < n; ++i) {
+        built.insert(make_pair(keys[i], keys[i]));
+    }
+    double t1 = now();
+    saveTree(built, path);
+    double t2 = now();
+    Tree loaded;
+    loadTree(loaded, path);
+    double t3 = now();
+    MappedTree<BenchKey, BenchKey> mapped(path);
+    double t4 = now();
+
+    BenchKey sum = 0;
+    for(size_t i = 0; i < n; ++i) {
+        sum += loaded.find(probes[i])->second;
+    }
+    double t5 = now();
+    for(size_t i = 0; i < n; ++i) {
+        sum -= mapped.find(probes[i])->second;
+    }
+    double t6 = now();
+    if(sum != 0 || loaded.size() != n || mapped.size() != n) cerr << "snapshot mismatch\n";
+    remove(path.c_str());
+
+    cout << left << setw(28) << "reinsert" << right << setw(14) << (t1 - t0) * 1e3 << "\n";
+    cout << left << setw(28) << "save" << right << setw(14) << (t2 - t1) * 1e3 << "\n";
+    cout << left << setw(28) << "load (AVLTree)" << right << setw(14) << (t3 - t2) * 1e3
+         << setw(14) << n / (t5 - t4) / 1e6 << "\n";
+    cout << left << setw(28) << "map (MappedTree)" << right << setw(14) << (t4 - t3) * 1e3
+         << setw(14) << n / (t6 - t5) / 1e6 << "\n";
+}
+
+/**
+ * Prints one phase's operation counts, per operation where that reads
+ * better than a total.
+ */
+static void printStats(const string& name, size_t ops, const TreeStats& s)
+{
+    cout << left << setw(28) << name << right << fixed << setprecision(2)
+         << setw(10) << double(s.comparisons) / ops
+         << setw(10) << double(s.nodesVisited) / ops
+         << setw(10) << double(s.iteratorSteps) / ops
+         << setw(10) << s.allocations << setw(10) << s.deallocations
+         << setw(10) << s.rotations << setw(10) << s.insertZigZig << setw(10) << s.insertZigZag
+         << setw(10) << s.removeCase1a << setw(10) << s.removeCase1b << setw(10) << s.removeCase1c << "\n";
+}
+
+/**
+ * Inserts keys, finds each, walks the tree and removes half the keys,
+ * printing the counts for each phase.
+ */
+template<typename Tree>
+void countPhases(const string& name, const vector<BenchKey>& keys)
+{
+    Tree tree;
+    size_t n = keys.size();
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    printStats(name + " insert", n, tree.stats());
+    tree.resetStats();
+    BenchKey sum = 0;
+    for(size_t i = 0; i < n; ++i) {
+        sum += tree.find(keys[i])->second;
+    }
+    printStats(name + " find", n, tree.stats());
+    tree.resetStats();
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        sum -= it->second;
+    }
+    if(sum != 0) cerr << "stats mismatch\n";
+    printStats(name + " iterate", n, tree.stats());
+    tree.resetStats();
+    for(size_t i = 0; i < n; i += 2) {
+        tree.remove(keys[i]);
+    }
+    printStats(name + " remove", (n + 1) / 2, tree.stats());
+}
+
+/**
+ * Operation counts for random and sorted workloads.  The counters only
+ * exist in builds with BST_STATS (make bst-bench-stats).
+ */
+void benchStats(size_t n)
+{
+    cout << "\noperation counts, " << n << " keys\n";
+    if(!BST_STATS) {
+        cout << "counters compiled out; run bst-bench-stats instead\n";
+        return;
+    }
+    cout << left << setw(28) << "phase" << right
+         << setw(10) << "cmp/op" << setw(10) << "visit/op" << setw(10) << "step/op"
+         << setw(10) << "allocs" << setw(10) << "frees" << setw(10) << "rotations"
+         << setw(10) << "zig-zig" << setw(10) << "zig-zag"
+         << setw(10) << "rm 1a" << setw(10) << "rm 1b" << setw(10) << "rm 1c" << "\n";
+    vector<BenchKey> random = randomKeys(n, 29);
+    vector<BenchKey> sorted(random);
+    sort(sorted.begin(), sorted.end());
+    countPhases<AVLTree<BenchKey, BenchKey> >("AVLTree random", random);
+    countPhases<AVLTree<BenchKey, BenchKey> >("AVLTree sorted", sorted);
+    countPhases<BinarySearchTree<BenchKey, BenchKey> >("BST random", random);
+}
+
+/*
+ * The regression suite: insert, find, remove, iteration and clear for
+ * BinarySearchTree, AVLTree and std::map, over several key distributions
+ * and key/value sizes, written as CSV or JSON rows for tracking.
+ */
+
+enum Distribution { RANDOM, SORTED, REVERSE, ZIPF };
+static const char* const distributionNames[] = { "random", "sorted", "reverse", "zipf" };
+
+// Every LATENCY_STRIDE-th operation is timed on its own for percentiles
+static const size_t LATENCY_STRIDE = 16;
+// Unbalanced trees go quadratic on sorted input, so they get fewer keys
+static const size_t UNBALANCED_SORTED_KEYS = 10000;
+// Zipf exponent of the skewed distribution
+static const double ZIPF_S = 0.99;
+
+static bool suiteJson = false;
+static bool suiteFirstRow = true;
+
+/**
+ * A fixed-size key or value of N bytes, ordered word by word.
+ */
+template<size_t N>
+struct Bytes {
+    uint64_t word[N / 8];
+
+    bool operator<(const Bytes& rhs) const
+    {
+        return lexicographical_compare(word, word + N / 8, rhs.word, rhs.word + N / 8);
+    }
+};
+
+// Trees need their items printable, for print()
+template<size_t N>
+ostream& operator<<(ostream& out, const Bytes<N>& b)
+{
+    return out << b.word[0];
+}
+
+template<typename T>
+static T makeItem(uint64_t k)
+{
+    return static_cast<T>(k);
+}
+
+template<>
+Bytes<32> makeItem<Bytes<32> >(uint64_t k)
+{
+    Bytes<32> b;
+    fill(b.word, b.word + 4, k);
+    return b;
+}
+
+template<>
+Bytes<128> makeItem<Bytes<128> >(uint64_t k)
+{
+    Bytes<128> b;
+    fill(b.word, b.word + 16, k);
+    return b;
+}
+
+// Scatters consecutive ranks over the key space (splitmix64)
+static uint64_t scatter(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * n keys drawn from n distinct ones, where the key of rank r turns up
+ * with probability proportional to 1 / (r + 1)^ZIPF_S.
+ */
+static vector<uint64_t> zipfKeys(size_t n, unsigned seed)
+{
+    vector<double> cdf(n);
+    double total = 0;
+    for(size_t r = 0; r < n; ++r) {
+        total += 1.0 / pow(r + 1.0, ZIPF_S);
+        cdf[r] = total;
+    }
+    mt19937_64 rng(seed);
+    uniform_real_distribution<double> u(0, total);
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        size_t r = lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin();
+        keys[i] = scatter(min(r, n - 1)) >> 32;
+    }
+    return keys;
+}
+
+/**
+ * Keys to insert.  Keys fit in 32 bits, so every key type holds them.
+ */
+static vector<uint64_t> workloadKeys(Distribution d, size_t n, unsigned seed)
+{
+    if(d == ZIPF) return zipfKeys(n, seed);
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = (d == REVERSE) ? n - i : i + 1;
+    }
+    if(d == RANDOM) shuffle(keys.begin(), keys.end(), mt19937_64(seed));
+    return keys;
+}
+
+/**
+ * Keys to look up and remove: the inserted keys shuffled, or for the
+ * skewed distribution a fresh draw, so popular keys are hit most.
+ */
+static vector<uint64_t> probeKeys(Distribution d, const vector<uint64_t>& keys, unsigned seed)
+{
+    if(d == ZIPF) return zipfKeys(keys.size(), seed);
+    vector<uint64_t> probes(keys);
+    shuffle(probes.begin(), probes.end(), mt19937_64(seed));
+    return probes;
+}
+
+template<typename Tree, typename K, typename V>
+static void suitePut(Tree& tree, const K& key, const V& value)
+{
+    tree.insert(make_pair(key, value));
+}
+
+template<typename K, typename V>
+static void suitePut(map<K, V>& tree, const K& key, const V& value)
+{
+    tree.insert_or_assign(key, value);
+}
+
+template<typename Tree, typename K>
+static void suiteErase(Tree& tree, const K& key)
+{
+    tree.remove(key);
+}
+
+template<typename K, typename V>
+static void suiteErase(map<K, V>& tree, const K& key)
+{
+    tree.erase(key);
+}
+
+/**
+ * Calls op(i) for every i < count and returns the seconds taken,
+ * timing every LATENCY_STRIDE-th call on its own into samples.
+ */
+template<typename Op>
+static double timedLoop(size_t count, vector<double>& samples, Op op)
+{
+    samples.clear();
+    double t0 = now();
+    for(size_t i = 0; i < count; ++i) {
+        if(i % LATENCY_STRIDE == 0) {
+            double s = now();
+            op(i);
+            samples.push_back(now() - s);
+        } else {
+            op(i);
+        }
+    }
+    return now() - t0;
+}
+
+static double percentile(vector<double>& samples, double p)
+{
+    size_t k = static_cast<size_t>(p * (samples.size() - 1));
+    nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+/**
+ * Writes one result row.  Operations timed as a whole (iteration and
+ * clear) have no latency samples and leave the percentiles empty.
+ */
+static void suiteRow(const string& tree, Distribution d, size_t keyBytes, size_t valueBytes, size_t n,
+                     const char* op, size_t ops, double seconds, vector<double>& samples)
+{
+    double mops = ops / seconds / 1e6;
+    double mean = seconds * 1e9 / ops;
+    bool timed = !samples.empty();
+    double p50 = timed ? percentile(samples, 0.5) * 1e9 : 0;
+    double p99 = timed ? percentile(samples, 0.99) * 1e9 : 0;
+    cout << fixed << setprecision(2);
+    if(suiteJson) {
+        cout << (suiteFirstRow ? "[\n" : ",\n")
+             << "{\"tree\":\"" << tree << "\",\"distribution\":\"" << distributionNames[d]
+             << "\",\"key_bytes\":" << keyBytes << ",\"value_bytes\":" << valueBytes
+             << ",\"n\":" << n << ",\"op\":\"" << op << "\",\"ops\":" << ops
+             << ",\"mops\":" << mops << ",\"ns_mean\":" << mean;
+        if(timed) {
+            cout << ",\"ns_p50\":" << p50 << ",\"ns_p99\":" << p99 << "}";
+        } else {
+            cout << ",\"ns_p50\":null,\"ns_p99\":null}";
+        }
+    } else {
+        cout << tree << "," << distributionNames[d] << "," << keyBytes << "," << valueBytes << ","
+             << n << "," << op << "," << ops << "," << mops << "," << mean << ",";
+        if(timed) cout << p50 << "," << p99;
+        else cout << ",";
+        cout << "\n";
+    }
+    suiteFirstRow = false;
+}
+
+/**
+ * Inserts n keys of distribution d, looks up n probes, walks the tree,
+ * removes half the probes and clears what is left.
+ */
+template<typename Tree, typename K, typename V>
+void suiteRun(const string& name, Distribution d, size_t n)
+{
+    vector<uint64_t> keys = workloadKeys(d, n, 31);
+    vector<uint64_t> probes = probeKeys(d, keys, 32);
+    vector<K> insertKeys(n), probeItems(n);
+    for(size_t i = 0; i < n; ++i) {
+        insertKeys[i] = makeItem<K>(keys[i]);
+        probeItems[i] = makeItem<K>(probes[i]);
+    }
+
+    Tree tree;
+    vector<double> samples;
+    double seconds = timedLoop(n, samples, [&](size_t i) {
+        suitePut(tree, insertKeys[i], makeItem<V>(keys[i]));
+    });
+    suiteRow(name, d, sizeof(K), sizeof(V), n, "insert", n, seconds, samples);
+
+    size_t found = 0;
+    seconds = timedLoop(n, samples, [&](size_t i) {
+        found += tree.find(probeItems[i]) != tree.end();
+    });
+    if(d != ZIPF && found != n) cerr << "suite: lookup mismatch\n";
+    suiteRow(name, d, sizeof(K), sizeof(V), n, "find", n, seconds, samples);
+
+    size_t items = 0;
+    double t0 = now();
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        ++items;
+    }
+    seconds = now() - t0;
+    samples.clear();
+    suiteRow(name, d, sizeof(K), sizeof(V), n, "iterate", items, seconds, samples);
+
+    seconds = timedLoop(n / 2, samples, [&](size_t i) {
+        suiteErase(tree, probeItems[i]);
+    });
+    suiteRow(name, d, sizeof(K), sizeof(V), n, "remove", n / 2, seconds, samples);
+
+    items = tree.size();
+    t0 = now();
+    tree.clear();
+    seconds = now() - t0;
+    samples.clear();
+    suiteRow(name, d, sizeof(K), sizeof(V), n, "clear", items > 0 ? items : 1, seconds, samples);
+}
+
+template<typename K, typename V>
+void suiteShape(size_t n)
+{
+    for(int d = RANDOM; d <= ZIPF; ++d) {
+        Distribution dist = static_cast<Distribution>(d);
+        size_t bstKeys = (dist == SORTED || dist == REVERSE) ? min(n, UNBALANCED_SORTED_KEYS) : n;
+        suiteRun<BinarySearchTree<K, V>, K, V>("BinarySearchTree", dist, bstKeys);
+        suiteRun<AVLTree<K, V>, K, V>("AVLTree", dist, n);
+        suiteRun<map<K, V>, K, V>("std::map", dist, n);
+    }
+}
+
+/**
+ * Runs the suite with n keys per run.  bst-bench suite n json writes
+ * JSON instead of CSV.
+ */
+void benchSuite(size_t n)
+{
+    suiteFirstRow = true;
+    if(!suiteJson) {
+        cout << "tree,distribution,key_bytes,value_bytes,n,op,ops,mops,ns_mean,ns_p50,ns_p99\n";
+    }
+    suiteShape<uint32_t, uint32_t>(n);
+    suiteShape<uint64_t, uint64_t>(n);
+    suiteShape<Bytes<32>, Bytes<128> >(n);
+    if(suiteJson) cout << "\n]\n";
+}
+
+/**
+ * A tree that can also be torn down the old way, by post-order
+ * recursion, and grown into one long right chain in O(n), as sorted
+ * inserts would leave it but without their O(n^2) descent.
+ */
+template<typename Tree, typename Node>
+class TeardownTree : public Tree
+{
+public:
+    void appendChain(size_t n)
+    {
+        Node* last = this->getLargestNode();
+        BenchKey key = last == NULL ? 0 : last->getKey() + 1;
+        for(size_t i = 0; i < n; ++i, ++key) {
+            Node* node = this->createNode(last, key, key);
+            this->linkLeaf(last, false, node);
+            last = node;
+        }
+    }
+
+    void clearRecursively()
+    {
+        destroy(this->root_);
+        this->root_ = NULL;
+        this->clear();
+    }
+
+protected:
+    void destroy(Node* n)
+    {
+        if(n == NULL) return;
+        destroy(n->getLeft());
+        destroy(n->getRight());
+        this->destroyNode(n);
+    }
+};
+
+/**
+ * Teardown time at 10n nodes: a balanced AVLTree freed recursively and
+ * with clear(), and a BinarySearchTree chain 10n levels deep, which only
+ * clear() can free without overflowing the stack.
+ */
+void benchTeardown(size_t n)
+{
+    typedef TeardownTree<AVLTree<BenchKey, BenchKey>, AVLNode<BenchKey, BenchKey> > Avl;
+    typedef TeardownTree<BinarySearchTree<BenchKey, BenchKey>, AVLNode<BenchKey, BenchKey> > Chain;
+    size_t m = 10 * n;
+    cout << "\nteardown\n";
+    cout << left << setw(28) << "tree" << right << setw(12) << "nodes"
+         << setw(14) << "ms" << setw(14) << "ns/node" << "\n";
+    cout << fixed << setprecision(2);
+
+    vector<pair<BenchKey, BenchKey> > items(m);
+    for(size_t i = 0; i < m; ++i) {
+        items[i] = make_pair(i, i);
+    }
+    for(int recursive = 1; recursive >= 0; --recursive) {
+        Avl tree;
+        tree.assign(items.begin(), items.end());
+        double t0 = now();
+        if(recursive) tree.clearRecursively();
+        else tree.clear();
+        double t1 = now();
+        cout << left << setw(28) << (recursive ? "AVLTree, recursive" : "AVLTree, clear()") << right
+             << setw(12) << m << setw(14) << (t1 - t0) * 1e3 << setw(14) << (t1 - t0) * 1e9 / m << "\n";
+    }
+    items.clear();
+    items.shrink_to_fit();
+
+    Chain chain;
+    chain.appendChain(m);
+    double t0 = now();
+    chain.clear();
+    double t1 = now();
+    cout << left << setw(28) << "BST chain, clear()" << right
+         << setw(12) << m << setw(14) << (t1 - t0) * 1e3 << setw(14) << (t1 - t0) * 1e9 / m << "\n";
+}
+
+/**
+ * The previous BinarySearchTree::insert, kept as a baseline: it recurses
+ * to the leaf and relinks every ancestor on the way back up, so sorted
+ * input costs O(depth) stack frames and writes per insert.
+ */
+class RecursiveBST : public BinarySearchTree<BenchKey, BenchKey, less<BenchKey>, CNode>
+{
+public:
+    virtual void insert(const pair<const BenchKey, BenchKey>& item)
+    {
+        root_ = insertHelper(root_, item, NULL);
+    }
+
+private:
+    CNode* insertHelper(CNode* root, const pair<const BenchKey, BenchKey>& item, CNode* parent)
+    {
+        if(root == NULL) {
+            return createNode(parent, item.first, item.second);
+        }
+        if(root->getKey() == item.first) {
+            root->setValue(item.second);
+        } else if(item.first < root->getKey()) {
+            root->setLeft(insertHelper(root->getLeft(), item, root));
+            root->getLeft()->setParent(root);
+        } else {
+            root->setRight(insertHelper(root->getRight(), item, root));
+            root->getRight()->setParent(root);
+        }
+        return root;
+    }
+};
+
+/**
+ * Sorted input, the regression case for the unbalanced tree: inserts
+ * into a tree that degenerates into a list, against the recursive
+ * baseline, and inserts at the bottom of a chain 10n levels deep, far
+ * past where recursion would run out of stack.
+ */
+void benchSortedInsert(size_t n)
+{
+    typedef BinarySearchTree<BenchKey, BenchKey, less<BenchKey>, CNode> Tree;
+    size_t k = min(n, UNBALANCED_SORTED_KEYS);
+    vector<BenchKey> sorted(k), reversed(k);
+    for(size_t i = 0; i < k; ++i) {
+        sorted[i] = i;
+        reversed[i] = k - i;
+    }
+    cout << "\nsorted insert\n";
+    cout << left << setw(28) << "tree" << right
+         << setw(14) << "ns/insert" << setw(14) << "writes/insert" << "\n";
+    insertWrites<RecursiveBST>("BST recursive, sorted", sorted);
+    insertWrites<Tree>("BST iterative, sorted", sorted);
+    insertWrites<Tree>("BST iterative, reversed", reversed);
+
+    TeardownTree<Tree, CNode> chain;
+    chain.appendChain(10 * n);
+    const size_t extra = 10;
+    CNode::writes = 0;
+    double t0 = now();
+    for(size_t i = 0; i < extra; ++i) {
+        chain.insert(make_pair(BenchKey(10 * n + i), BenchKey(i)));
+    }
+    double t1 = now();
+    cout << left << setw(28) << "BST iterative, 10n deep" << right << fixed << setprecision(2)
+         << setw(14) << (t1 - t0) * 1e9 / extra
+         << setw(14) << double(CNode::writes) / extra << "\n";
+
+    vector<BenchKey> all(n);
+    for(size_t i = 0; i < n; ++i) {
+        all[i] = i;
+    }
+    insertWrites<AVLTree<BenchKey, BenchKey, less<BenchKey>, CNode> >("AVLTree, sorted", all);
+}
+
+/**
+ * Health checks on a large AVL tree: the O(1) and O(log n) queries a
+ * monitor can poll, against the full scans of the general BST check
+ * and validate(), which a split or set operation does not change.
+ */
+void benchHealth(size_t n)
+{
+    typedef AVLTree<BenchKey, BenchKey> Tree;
+    vector<BenchKey> keys = randomKeys(n, 11);
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    const size_t calls = 1000000;
+    size_t sink = 0;
+    cout << "\nhealth checks, " << n << " items\n";
+    cout << left << setw(28) << "query" << right << setw(14) << "ns/call" << setw(14) << "result" << "\n";
+
+    double t0 = now();
+    for(size_t i = 0; i < calls; ++i) sink += tree.size();
+    double t1 = now();
+    for(size_t i = 0; i < calls; ++i) sink += tree.height();
+    double t2 = now();
+    for(size_t i = 0; i < calls; ++i) sink += tree.isBalanced();
+    double t3 = now();
+    bool scanned = tree.Tree::BinarySearchTree::isBalanced();
+    double t4 = now();
+    tree.validate();
+    double t5 = now();
+
+    cout << fixed << setprecision(2);
+    cout << left << setw(28) << "size()" << right << setw(14) << (t1 - t0) * 1e9 / calls
+         << setw(14) << tree.size() << "\n";
+    cout << left << setw(28) << "height()" << right << setw(14) << (t2 - t1) * 1e9 / calls
+         << setw(14) << tree.height() << "\n";
+    cout << left << setw(28) << "isBalanced()" << right << setw(14) << (t3 - t2) * 1e9 / calls
+         << setw(14) << tree.isBalanced() << "\n";
+    cout << left << setw(28) << "isBalanced(), full scan" << right << setw(14) << (t4 - t3) * 1e9
+         << setw(14) << scanned << "\n";
+    cout << left << setw(28) << "validate()" << right << setw(14) << (t5 - t4) * 1e9
+         << setw(14) << "ok" << "\n";
+    if(sink == 0) cout << "unexpected empty tree\n";
+}
+
+// Keys in the hot set of the splay benchmark
+static const size_t SPLAY_HOT_KEYS = 16;
+
+/**
+ * Times n lookups of probes in tree, which holds every probe key.
+ */
+template<typename Tree>
+static double findTime(Tree& tree, const vector<uint64_t>& probes)
+{
+    uint64_t sum = 0;
+    double t0 = now();
+    for(size_t i = 0; i < probes.size(); ++i) {
+        sum += tree.find(probes[i])->second;
+    }
+    double t1 = now();
+    if(sum == 0) cout << "unexpected zero checksum\n";
+    return (t1 - t0) * 1e9 / probes.size();
+}
+
+/**
+ * One row of splay-vs-AVL: inserts the n keys in random order, then
+ * looks them up uniformly, with Zipf skew and from a small hot set.
+ */
+template<typename Tree>
+static void splayRow(const string& name, const vector<uint64_t>& keys, const vector<uint64_t>& uniform,
+                     const vector<uint64_t>& skewed, const vector<uint64_t>& hot)
+{
+    Tree tree;
+    double t0 = now();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i] | 1));
+    }
+    double t1 = now();
+    double u = findTime(tree, uniform);
+    double z = findTime(tree, skewed);
+    double h = findTime(tree, hot);
+    cout << left << setw(28) << name << right << fixed << setprecision(2)
+         << setw(14) << (t1 - t0) * 1e9 / keys.size()
+         << setw(14) << u << setw(14) << z << setw(14) << h << "\n";
+}
+
+/**
+ * Splay tree against AVL tree, with the key of rank r the same in every
+ * lookup stream, so the Zipf stream hits the low ranks most and the hot
+ * stream only the lowest SPLAY_HOT_KEYS.
+ */
+void benchSplay(size_t n)
+{
+    vector<uint64_t> keys(n);
+    for(size_t r = 0; r < n; ++r) {
+        keys[r] = scatter(r) >> 32;
+    }
+    vector<uint64_t> uniform(keys);
+    shuffle(keys.begin(), keys.end(), mt19937_64(12));
+    shuffle(uniform.begin(), uniform.end(), mt19937_64(13));
+    vector<uint64_t> skewed = zipfKeys(n, 14);
+    vector<uint64_t> hot(n);
+    mt19937_64 rng(15);
+    for(size_t i = 0; i < n; ++i) {
+        hot[i] = scatter(rng() % min(n, SPLAY_HOT_KEYS)) >> 32;
+    }
+
+    cout << "\nsplay vs AVL, " << n << " keys\n";
+    cout << left << setw(28) << "tree" << right << setw(14) << "ns/insert"
+         << setw(14) << "ns/find unif" << setw(14) << "ns/find zipf" << setw(14) << "ns/find hot" << "\n";
+    splayRow<AVLTree<uint64_t, uint64_t> >("AVLTree", keys, uniform, skewed, hot);
+    splayRow<SplayTree<uint64_t, uint64_t> >("SplayTree", keys, uniform, skewed, hot);
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)(size_t n);
+};
+
+static const Benchmark benchmarks[] = {
+    { "pool", benchPool },
+    { "avl-insert", benchAvlInsert },
+    { "order-stat", benchOrderStatistics },
+    { "compare", benchCompare },
+    { "split-join", benchSplitJoin },
+    { "set-ops", benchSetOps },
+    { "snapshot", benchSnapshots },
+    { "concurrent", benchConcurrent },
+    { "btree", benchBTree },
+    { "frozen", benchFrozen },
+    { "compact", benchCompact },
+    { "iterate", benchIterate },
+    { "startup", benchStartup },
+    { "suite", benchSuite },
+    { "stats", benchStats },
+    { "teardown", benchTeardown },
+    { "sorted-insert", benchSortedInsert },
+    { "health", benchHealth },
+    { "splay", benchSplay },
+};
+
+int main(int argc, char *argv[])
+{
+    // usage: bst-bench [benchmark|all] [elements] [csv|json]
+    const char* which = argc > 1 ? argv[1] : "all";
+    size_t n = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    suiteJson = argc > 3 && strcmp(argv[3], "json") == 0;
+
+    bool ran = false;
+    for(size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i) {
+        if(strcmp(which, "all") == 0 || strcmp(which, benchmarks[i].name) == 0) {
+            benchmarks[i].run(n);
+            ran = true;
+        }
+    }
+    if(!ran) {
+        cerr << "Unknown benchmark " << which << endl;
+        return 1;
+    }
+    return 0;
+}
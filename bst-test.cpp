@@ -1,10 +1,121 @@
 #include <iostream>
 #include <map>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 #include "bst.h"
 #include "avlbst.h"
+#include "splaybst.h"
+#include "persistent_avl.h"
+#include "concurrent_avl.h"
+#include "btree.h"
+#include "compact_avl.h"
+#include "frozen_tree.h"
+#include "tree_snapshot.h"
 
 using namespace std;
 
+static int failures = 0;
+
+/**
+ * Records a failed check, reporting what was expected, and carries on so
+ * one run shows every failure.  main() returns non-zero if any failed.
+ */
+static void check(bool ok, const string& what)
+{
+    if(!ok) {
+        cout << "FAILED: " << what << endl;
+        ++failures;
+    }
+}
+
+/**
+ * True if [first, last) holds exactly the items of expected, in order.
+ */
+template<typename It, typename Map>
+static bool sameItems(It first, It last, const Map& expected)
+{
+    typename Map::const_iterator want = expected.begin();
+    for(; first != last; ++first, ++want) {
+        if(want == expected.end() || first->first != want->first || first->second != want->second) {
+            return false;
+        }
+    }
+    return want == expected.end();
+}
+
+/**
+ * Runs ops random inserts, removes and lookups on tree and on a std::map
+ * side by side, checking each lookup, the size and the tree's invariants
+ * as it goes and the full contents in both directions at the end.
+ */
+template<typename Tree>
+static void checkAgainstMap(const string& name, Tree& tree, unsigned seed, int ops)
+{
+    mt19937 rng(seed);
+    map<int,int> expected;
+    for(int i = 0; i < ops; ++i) {
+        int key = rng() % 500;
+        switch(rng() % 4) {
+        case 0:
+        case 1:
+            tree.insert(make_pair(key, i));
+            expected[key] = i;
+            break;
+        case 2:
+            tree.remove(key);
+            expected.erase(key);
+            break;
+        default:
+            check((tree.find(key) == tree.end()) == (expected.count(key) == 0), name + ": find");
+            typename Tree::iterator lb = tree.lower_bound(key);
+            map<int,int>::iterator want = expected.lower_bound(key);
+            check((lb == tree.end()) == (want == expected.end()) && (lb == tree.end() || lb->first == want->first),
+                  name + ": lower_bound");
+        }
+        if(i % 500 == 0) tree.validate();
+    }
+    tree.validate();
+    check(tree.size() == expected.size(), name + ": size");
+    check(sameItems(tree.begin(), tree.end(), expected), name + ": contents");
+    check(sameItems(tree.rbegin(), tree.rend(), map<int,int,greater<int> >(expected.begin(), expected.end())),
+          name + ": reverse contents");
+}
+
+/**
+ * The items of tree as a std::map, for comparing trees with each other.
+ */
+template<typename Tree>
+static map<int,int> itemsOf(const Tree& tree)
+{
+    return map<int,int>(tree.begin(), tree.end());
+}
+
+/**
+ * A tree of n random keys below range, built by inserts, with the same
+ * items mirrored in expected.
+ */
+static AVLTree<int,int> randomTree(int n, int range, unsigned seed, map<int,int>& expected)
+{
+    mt19937 rng(seed);
+    AVLTree<int,int> tree;
+    expected.clear();
+    for(int i = 0; i < n; ++i) {
+        int key = rng() % range;
+        tree.insert(make_pair(key, i));
+        expected[key] = i;
+    }
+    return tree;
+}
+
 
 int main(int argc, char *argv[])
 {
@@ -12,7 +123,7 @@ int main(int argc, char *argv[])
     BinarySearchTree<char,int> bt;
     bt.insert(std::make_pair('a',1));
     bt.insert(std::make_pair('b',2));
-    
+
     cout << "Binary Search Tree contents:" << endl;
     for(BinarySearchTree<char,int>::iterator it = bt.begin(); it != bt.end(); ++it) {
         cout << it->first << " " << it->second << endl;
@@ -25,6 +136,7 @@ int main(int argc, char *argv[])
     }
     cout << "Erasing b" << endl;
     bt.remove('b');
+    check(bt.size() == 1 && bt.find('b') == bt.end() && bt.find('a')->second == 1, "BST: erase b");
 
     // AVL Tree Tests
     AVLTree<char,int> at;
@@ -43,6 +155,362 @@ int main(int argc, char *argv[])
     }
     cout << "Erasing b" << endl;
     at.remove('b');
+    check(at.size() == 1 && at.find('b') == at.end() && at.find('a')->second == 1, "AVLTree: erase b");
+
+    // Randomized against std::map
+    BinarySearchTree<int,int> randomBst;
+    checkAgainstMap("BST", randomBst, 1, 20000);
+    AVLTree<int,int> randomAvl;
+    checkAgainstMap("AVLTree", randomAvl, 2, 20000);
+    check(randomAvl.isBalanced(), "AVLTree: isBalanced");
+    AVLTree<int,int> viaBase;
+    BinarySearchTree<int,int>& base = viaBase;
+    for(int i = 0; i < 100; ++i) base.insert(make_pair(i, i));
+    base.remove(0);
+    viaBase.validate();
+    check(viaBase.size() == 99 && viaBase.height() <= 9, "AVLTree: insert through BinarySearchTree&");
+    BinarySearchTree<int,int> single;
+    single.insert(make_pair(1, 1));
+    single.remove(1);
+    single.validate();
+    check(single.empty() && single.rbegin() == single.rend(), "BST: remove the only node");
+    SplayTree<int,int> randomSplay;
+    checkAgainstMap("SplayTree", randomSplay, 3, 20000);
+    CompactAVLTree<int,int> randomCompact;
+    checkAgainstMap("CompactAVLTree", randomCompact, 4, 20000);
+
+    // Bulk load from sorted input
+    map<char,int> sorted;
+    for(char c = 'a'; c <= 'g'; ++c) {
+        sorted[c] = c - 'a';
+    }
+    AVLTree<char,int> bulk(sorted.begin(), sorted.end());
+    cout << "\nBulk loaded AVLTree contents:" << endl;
+    for(AVLTree<char,int>::iterator it = bulk.begin(); it != bulk.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    bulk.print();
+    bt.assign(sorted.begin(), sorted.end());
+    cout << "Bulk loaded BST is " << (bt.isBalanced() ? "balanced" : "not balanced") << endl;
+    bulk.validate();
+    bt.validate();
+    check(sameItems(bulk.begin(), bulk.end(), sorted) && sameItems(bt.begin(), bt.end(), sorted), "bulk load: contents");
+    check(bt.isBalanced() && bulk.isBalanced(), "bulk load: balanced");
+
+    // Range queries
+    cout << "\nKeys in [c, f):";
+    for(AVLTree<char,int>::iterator it = bulk.range('c', 'f').begin(); it != bulk.range('c', 'f').end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+    cout << "lower_bound(x) is " << (bulk.lower_bound('x') == bulk.end() ? "end" : "not end") << endl;
+    cout << "upper_bound(c) is " << bulk.upper_bound('c')->first << endl;
+    string inRange;
+    for(const pair<const char,int>& item : bulk.range('c', 'f')) inRange += item.first;
+    check(inRange == "cde" && bulk.range('f', 'c').begin() == bulk.end(), "range");
+    check(bulk.lower_bound('x') == bulk.end() && bulk.upper_bound('c')->first == 'd', "lower_bound, upper_bound");
+
+    // Order statistics
+    AVLTree<char,int,less<char>,SizedNode<AVLNode<char,int> > > ranked(sorted.begin(), sorted.end());
+    ranked.remove('b');
+    cout << "\nsize is " << ranked.size() << ", select(2) is " << ranked.select(2)->first
+         << ", rank(e) is " << ranked.rank('e') << endl;
+    ranked.validate();
+    check(ranked.size() == 6 && ranked.select(2)->first == 'd' && ranked.rank('e') == 3
+          && ranked.select(6) == ranked.end(), "select, rank");
+
+    // Move-aware insertion
+    AVLTree<string,string> words;
+    words.emplace("one", "uno");
+    words.insert(make_pair(string("two"), string("dos")));
+    words.try_emplace("three", 4, 't');
+    bool added = words.try_emplace("one", "eins").second;
+    words.emplace("two", "deux");
+    cout << "\ntry_emplace(one) " << (added ? "added" : "kept") << " " << words["one"]
+         << ", two is " << words["two"] << ", three is " << words["three"] << endl;
+    check(!added && words["one"] == "uno" && words["two"] == "deux" && words["three"] == "tttt",
+          "emplace, try_emplace");
+
+    // Custom ordering and heterogeneous lookup
+    AVLTree<char,int,greater<char> > reversed(sorted.rbegin(), sorted.rend());
+    cout << "\nDescending:";
+    for(AVLTree<char,int,greater<char> >::iterator it = reversed.begin(); it != reversed.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+    AVLTree<string,string,less<> > lookup;
+    lookup.insert(make_pair(string("hello"), string("world")));
+    string_view probe = "hello";
+    cout << "find(string_view) gives " << lookup.find(probe)->second << endl;
+    check(reversed.begin()->first == 'g' && reversed.rbegin()->first == 'a', "greater<char> order");
+    check(lookup.find(probe) != lookup.end() && lookup.find(string_view("help")) == lookup.end(),
+          "heterogeneous find");
+
+    // Split and join
+    pair<AVLTree<char,int>, AVLTree<char,int> > halves = bulk.split('d');
+    cout << "\nsplit at d: " << halves.first.size() << " below, " << halves.second.size() << " from d on" << endl;
+    AVLTree<char,int> joined = AVLTree<char,int>::join(move(halves.first), move(halves.second));
+    joined.print();
+    joined.validate();
+    check(sameItems(joined.begin(), joined.end(), sorted) && bulk.empty(), "split and join: round trip");
+
+    // Split and join random trees
+    for(unsigned seed = 0; seed < 20; ++seed) {
+        map<int,int> expected;
+        AVLTree<int,int> whole = randomTree(300, 1000, seed, expected);
+        int key = seed * 53 % 1000;
+        pair<AVLTree<int,int>, AVLTree<int,int> > parts = whole.split(key);
+        parts.first.validate();
+        parts.second.validate();
+        check(parts.first.isBalanced() && parts.second.isBalanced(), "split: isBalanced");
+        map<int,int> below(expected.begin(), expected.lower_bound(key));
+        map<int,int> above(expected.lower_bound(key), expected.end());
+        check(sameItems(parts.first.begin(), parts.first.end(), below)
+              && sameItems(parts.second.begin(), parts.second.end(), above), "split: halves");
+        check(parts.first.size() == below.size() && parts.second.size() == above.size(), "split: sizes");
+        AVLTree<int,int> back = AVLTree<int,int>::join(move(parts.first), move(parts.second));
+        back.validate();
+        check(itemsOf(back) == expected && back.size() == expected.size(), "join: contents");
+    }
+
+    // Set operations
+    AVLTree<char,int> evens, vowels;
+    for(char c = 'a'; c <= 'j'; c += 2) evens.insert(make_pair(c, 0));
+    vowels.insert(make_pair('a', 1));
+    vowels.insert(make_pair('e', 1));
+    vowels.insert(make_pair('i', 1));
+    vowels.insert(make_pair('o', 1));
+    AVLTree<char,int> both = AVLTree<char,int>::setIntersection(move(evens), move(vowels));
+    cout << "\nIntersection:";
+    for(AVLTree<char,int>::iterator it = both.begin(); it != both.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+    both.validate();
+    check(both.size() == 3 && both.find('a') != both.end() && both.find('e') != both.end()
+          && both.find('i') != both.end(), "set intersection");
+
+    // Set operations on random trees
+    for(unsigned seed = 0; seed < 6; ++seed) {
+        map<int,int> a, b;
+        AVLTree<int,int> ta = randomTree(5000, 8000, 100 + seed, a);
+        AVLTree<int,int> tb = randomTree(3000, 8000, 200 + seed, b);
+        map<int,int> want;
+        AVLTree<int,int> result;
+        if(seed % 3 == 0) {
+            want = b;
+            for(map<int,int>::iterator it = a.begin(); it != a.end(); ++it) want[it->first] = it->second;
+            result = AVLTree<int,int>::setUnion(move(ta), move(tb));
+        } else {
+            bool keepShared = (seed % 3 == 1);
+            for(map<int,int>::iterator it = a.begin(); it != a.end(); ++it) {
+                if((b.count(it->first) != 0) == keepShared) want.insert(*it);
+            }
+            result = keepShared ? AVLTree<int,int>::setIntersection(move(ta), move(tb))
+                                : AVLTree<int,int>::setDifference(move(ta), move(tb));
+        }
+        result.validate();
+        check(itemsOf(result) == want && result.size() == want.size(), "set operation " + to_string(seed % 3));
+        check(ta.empty() && tb.empty(), "set operation: inputs emptied");
+    }
+
+    // Persistent snapshots
+    PersistentAVLTree<char,int> versions;
+    for(char c = 'a'; c <= 'e'; ++c) versions.insert(make_pair(c, 1));
+    PersistentAVLTree<char,int>::Snapshot before = versions.snapshot();
+    versions.remove('c');
+    versions.insert(make_pair('a', 2));
+    PersistentAVLTree<char,int>::Snapshot after = versions.snapshot();
+    cout << "\nBefore:";
+    for(PersistentAVLTree<char,int>::Snapshot::iterator it = before.begin(); it != before.end(); ++it) {
+        cout << " " << it->first << it->second;
+    }
+    cout << "\nAfter:";
+    for(PersistentAVLTree<char,int>::Snapshot::iterator it = after.begin(); it != after.end(); ++it) {
+        cout << " " << it->first << it->second;
+    }
+    cout << endl;
+    check(before.size() == 5 && *before.find('a') == 1 && before.find('c') != NULL, "persistent: before");
+    check(after.size() == 4 && *after.find('a') == 2 && after.find('c') == NULL, "persistent: after");
+
+    // Concurrent map
+    ConcurrentAVLTree<char,int> sharedMap;
+    sharedMap.insert(make_pair('x', 24));
+    sharedMap.insert(make_pair('y', 25));
+    sharedMap.remove('y');
+    int found = 0;
+    bool hasX = sharedMap.find('x', found);
+    cout << "\nConcurrent: size " << sharedMap.size() << ", x " << (hasX ? "found" : "missing")
+         << " with " << found << ", y " << (sharedMap.contains('y') ? "found" : "missing") << endl;
+    check(hasX && found == 24 && sharedMap.size() == 1 && !sharedMap.contains('y'), "concurrent map");
+    for(char c = 'a'; c <= 'z'; ++c) sharedMap.insert(make_pair(c, c - 'a'));
+    string walked;
+    sharedMap.forEach([&](const pair<const char,int>& item) { walked += item.first; });
+    check(walked == "abcdefghijklmnopqrstuvwxyz", "concurrent map: forEach in key order");
+    check(sharedMap.remove('q') && !sharedMap.remove('q') && !sharedMap.contains('q') && sharedMap.size() == 25,
+          "concurrent map: remove reports whether the key was there");
+
+    // Finds racing with writers: the even keys are never removed, so every
+    // lookup of one must succeed with its value while the odd keys churn
+    ConcurrentAVLTree<int,int> churned;
+    for(int i = 0; i < 2000; ++i) churned.insert(make_pair(i, i * 3));
+    atomic<bool> stop(false);
+    atomic<int> misses(0);
+    vector<thread> writers, readers;
+    for(int t = 0; t < 2; ++t) {
+        writers.push_back(thread([&churned, t]() {
+            mt19937 rng(t);
+            for(int i = 0; i < 20000; ++i) {
+                int key = 2 * (rng() % 1000) + 1;
+                churned.remove(key);
+                churned.insert(make_pair(key, key * 3));
+            }
+        }));
+        readers.push_back(thread([&churned, &stop, &misses, t]() {
+            mt19937 rng(10 + t);
+            while(!stop) {
+                int key = 2 * (rng() % 1000);
+                int value = -1;
+                if(!churned.find(key, value) || value != key * 3 || !churned.contains(key)) ++misses;
+            }
+        }));
+    }
+    for(size_t t = 0; t < writers.size(); ++t) writers[t].join();
+    stop = true;
+    for(size_t t = 0; t < readers.size(); ++t) readers[t].join();
+    check(misses == 0 && churned.size() == 2000, "concurrent map: finds during writes");
+
+    // B-tree with the same interface
+    BTree<int,int> wide;
+    for(int i = 0; i < 1000; ++i) wide.insert(make_pair(i, i * i));
+    for(int i = 0; i < 1000; i += 2) wide.remove(i);
+    cout << "\nBTree: size " << wide.size() << ", first " << wide.begin()->first
+         << ", [31] is " << wide[31] << endl;
+    map<int,int> odd;
+    for(int i = 1; i < 1000; i += 2) odd[i] = i * i;
+    check(wide.size() == 500 && sameItems(wide.begin(), wide.end(), odd), "BTree: removal");
+    {
+        mt19937 rng(5);
+        BTree<int,int> churn;
+        map<int,int> expected;
+        for(int i = 0; i < 20000; ++i) {
+            int key = rng() % 2000;
+            if(rng() % 2) {
+                churn.insert(make_pair(key, i));
+                expected[key] = i;
+            } else {
+                churn.remove(key);
+                expected.erase(key);
+            }
+        }
+        check(churn.size() == expected.size() && sameItems(churn.begin(), churn.end(), expected),
+              "BTree: random inserts and removes");
+        const BTree<int,int>& view = churn;
+        check(sameItems(view.rbegin(), view.rend(), map<int,int,greater<int> >(expected.begin(), expected.end())),
+              "BTree: reverse contents");
+        BTree<int,int>::const_iterator last = prev(view.end());
+        check(last->first == expected.rbegin()->first && next(view.lower_bound(last->first)) == view.end()
+              && count_if(view.begin(), view.end(), [](const pair<const int,int>& item) { return item.first % 2 == 0; })
+                 == count_if(expected.begin(), expected.end(), [](const pair<const int,int>& item) { return item.first % 2 == 0; }),
+              "BTree: const iterators and algorithms");
+    }
+
+    // Frozen read-only copy
+    AVLTree<int,int> squares;
+    for(BTree<int,int>::iterator it = wide.begin(); it != wide.end(); ++it) squares.insert(*it);
+    FrozenTree<int,int> frozen = squares.freeze();
+    cout << "Frozen: size " << frozen.size() << ", lower_bound(500) is " << frozen.lower_bound(500)->first
+         << ", [31] is " << frozen[31] << endl;
+    bool agree = frozen.size() == squares.size();
+    for(int key = -1; key <= 1001; ++key) {
+        AVLTree<int,int>::iterator want = squares.lower_bound(key);
+        FrozenTree<int,int>::iterator got = frozen.lower_bound(key);
+        agree = agree && (got == frozen.end()) == (want == squares.end())
+            && (got == frozen.end() || got->first == want->first)
+            && (frozen.find(key) == frozen.end()) == (squares.find(key) == squares.end());
+    }
+    check(agree, "FrozenTree: lookups match the tree");
+
+    // Compact 32-bit index nodes
+    CompactAVLTree<uint16_t,uint16_t> small;
+    for(uint16_t i = 0; i < 100; ++i) small.insert(make_pair(i, uint16_t(i * 2)));
+    small.remove(50);
+    cout << "Compact: size " << small.size() << ", balanced " << small.isBalanced()
+         << ", " << sizeof(CompactAVLNode<uint16_t,uint16_t>) << " bytes per node" << endl;
+    small.validate();
+    check(small.size() == 99 && small.find(50) == small.end() && small[49] == 98, "CompactAVLTree");
+
+    // Cursor walk
+    cout << "\nCursor:";
+    string cursorKeys;
+    for(pair<const char,int>& item : joined.inorder()) {
+        cout << " " << item.first;
+        cursorKeys += item.first;
+    }
+    cout << endl;
+    check(cursorKeys == "abcdefg", "cursor walk");
+
+    // Reverse walk
+    cout << "Reverse:";
+    for(AVLTree<char,int>::reverse_iterator it = joined.rbegin(); it != joined.rend(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Standard algorithms over a const tree
+    const AVLTree<char,int>& view = joined;
+    int total = 0;
+    for_each(view.cbegin(), view.cend(), [&](const pair<const char,int>& item) { total += item.second; });
+    AVLTree<char,int>::const_iterator second = view.begin();
+    second++;
+    cout << "Const: " << distance(view.begin(), view.end()) << " items, second is " << second->first
+         << ", values sum to " << total << endl;
+    check(distance(view.begin(), view.end()) == 7 && second->first == 'b' && total == 21, "const iteration");
+
+    // Snapshot round trip
+    saveTree(joined, "bst-test.snapshot");
+    AVLTree<char,int> restored;
+    loadTree(restored, "bst-test.snapshot");
+    MappedTree<char,int> mapped("bst-test.snapshot");
+    remove("bst-test.snapshot");
+    cout << "Snapshot: loaded " << restored.size() << " items, balanced " << restored.isBalanced()
+         << ", mapped ['e'] is " << mapped['e'] << endl;
+    restored.validate();
+    check(sameItems(restored.begin(), restored.end(), sorted) && sameItems(mapped.begin(), mapped.end(), sorted),
+          "snapshot: round trip");
+    vector<pair<char,int> > unordered = { make_pair('a', 1), make_pair('c', 3), make_pair('b', 2) };
+    writeSnapshot<char,int>("bst-test.snapshot", unordered.begin(), unordered.size());
+    bool rejected = false;
+    try {
+        loadTree(restored, "bst-test.snapshot");
+    } catch(const runtime_error&) {
+        rejected = true;
+    }
+    remove("bst-test.snapshot");
+    check(rejected && restored.size() == 7, "snapshot: keys out of order rejected");
+
+    // Health checks
+    joined.validate();
+    cout << "Health: size " << joined.size() << ", height " << joined.height()
+         << ", balanced " << joined.isBalanced() << ", validated" << endl;
+    check(joined.height() <= 4 && joined.isBalanced(), "height, isBalanced");
+
+    // Splay tree
+    SplayTree<char,int> splayed(sorted.begin(), sorted.end());
+    splayed.find('f');
+    splayed.insert(make_pair('z', 25));
+    splayed.remove('a');
+    splayed.validate();
+    cout << "Splay: size " << splayed.size() << ", f is " << splayed['f']
+         << ", first " << splayed.begin()->first << ", last " << splayed.rbegin()->first << endl;
+    SplayTree<int,int> splayOne;
+    splayOne.insert(make_pair(1, 1));
+    splayOne.remove(1);
+    splayOne.validate();
+    check(splayOne.empty(), "SplayTree: remove the only node");
+    check(splayed.size() == 7 && splayed['f'] == 5 && splayed.begin()->first == 'b'
+          && splayed.rbegin()->first == 'z', "SplayTree");
 
-    return 0;
+    cout << "\n" << (failures == 0 ? string("All checks passed") : to_string(failures) + " checks failed") << endl;
+    return failures == 0 ? 0 : 1;
 }
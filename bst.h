@@ -3,23 +3,43 @@
 
 #include <iostream>
 #include <exception>
+#include <stdexcept>
 #include <cstdlib>
+#include <cstdint>
 #include <utility>
 #include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "node_pool.h"
+#include "tree_stats.h"
+
+// Defined in frozen_tree.h, which callers of freeze() include
+template <typename Key, typename Value, typename Compare>
+class FrozenTree;
 
 /**
  * A templated class for a Node in a search tree.
- * The getters for parent/left/right are virtual so
- * that they can be overridden for future kinds of
- * search trees, such as Red Black trees, Splay trees,
- * and AVL trees.
+ * The getters for parent/left/right can be redefined
+ * by nodes for future kinds of search trees, such as
+ * Red Black trees, Splay trees, and AVL trees, to return
+ * their own node type.  They are not virtual: the tree
+ * is told the concrete node type, so a node carries no
+ * vtable and following a link is a plain load.
  */
 template <typename Key, typename Value>
 class Node
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-    virtual ~Node();
+    template<typename... Args>
+    Node(Node<Key, Value>* parent, Args&&... args);
+    ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
     std::pair<const Key, Value>& getItem();
@@ -27,14 +47,19 @@ public:
     const Value& getValue() const;
     Value& getValue();
 
-    virtual Node<Key, Value>* getParent() const;
-    virtual Node<Key, Value>* getLeft() const;
-    virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getParent() const;
+    Node<Key, Value>* getLeft() const;
+    Node<Key, Value>* getRight() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
+    void setValue(Value&& value);
+    void setSubtreeHeights(int leftHeight, int rightHeight);
+
+    // Whether the node stores its subtree size (see SizedNode)
+    static const bool TRACKS_SIZE = false;
 
 protected:
     std::pair<const Key, Value> item_;
@@ -62,6 +87,21 @@ Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* par
 
 }
 
+/**
+* Constructs the item in place from args, as for the pair constructors,
+* so keys and values can be moved in or built directly in the node.
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+Node<Key, Value>::Node(Node<Key, Value>* parent, Args&&... args) :
+    item_(std::forward<Args>(args)...),
+    parent_(parent),
+    left_(NULL),
+    right_(NULL)
+{
+
+}
+
 /**
 * Destructor, which does not need to do anything since the pointers inside of a node
 * are only used as references to existing nodes. The nodes pointed to by parent/left/right
@@ -120,7 +160,7 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
@@ -129,7 +169,7 @@ Node<Key, Value>* Node<Key, Value>::getParent() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -138,7 +178,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -182,6 +222,26 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* A setter that moves the new value into the node.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setValue(Value&& value)
+{
+    item_.second = std::move(value);
+}
+
+/**
+* Called when a tree is built in bulk with the heights of the node's
+* subtrees.  A plain node keeps no balance information, so this does
+* nothing; node types that do (e.g. AVLNode) redefine it.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setSubtreeHeights(int leftHeight, int rightHeight)
+{
+
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
@@ -189,396 +249,1823 @@ void Node<Key, Value>::setValue(const Value& value)
 */
 
 /**
-* A templated unbalanced binary search tree.
+* A special kind of node for an AVL tree, which adds the balance as a data member, plus
+* other additional helper functions. You do NOT need to implement any functionality or
+* add additional data members or helper functions.
+* It is also the default node of BinarySearchTree, so that AVLTree<Key, Value>
+* is a BinarySearchTree<Key, Value>; a plain tree ignores the balance.
 */
 template <typename Key, typename Value>
-class BinarySearchTree
+class AVLNode : public Node<Key, Value>
 {
 public:
-    BinarySearchTree(); //TODO
-    virtual ~BinarySearchTree(); //TODO
-    virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
-    virtual void remove(const Key& key); //TODO
-    void clear(); //TODO
-    bool isBalanced() const; //TODO
-    void print() const;
-    bool empty() const;
-
-    template<typename PPKey, typename PPValue>
-    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
-public:
-    /**
-    * An internal iterator class for traversing the contents of the BST.
-    */
-    class iterator  // TODO
-    {
-    public:
-        iterator();
-
-        std::pair<const Key,Value>& operator*() const;
-        std::pair<const Key,Value>* operator->() const;
-
-        bool operator==(const iterator& rhs) const;
-        bool operator!=(const iterator& rhs) const;
-
-        iterator& operator++();
-
-    protected:
-        friend class BinarySearchTree<Key, Value>;
-        iterator(Node<Key,Value>* ptr);
-        Node<Key, Value> *current_;
-    };
-
-public:
-    iterator begin() const;
-    iterator end() const;
-    iterator find(const Key& key) const;
-    Value& operator[](const Key& key);
-    Value const & operator[](const Key& key) const;
-
-protected:
-    // Mandatory helper functions
-    Node<Key, Value>* internalFind(const Key& k) const; // TODO
-    Node<Key, Value> *getSmallestNode() const;  // TODO
-    static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
-    // Note:  static means these functions don't have a "this" pointer
-    //        and instead just use the input argument.
-
-    // Provided helper functions
-    virtual void printRoot (Node<Key, Value> *r) const;
-    virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
-
-    // Add helper functions here
-		Node<Key, Value>* insertHelper(Node<Key, Value>* root, const std::pair<const Key, Value>& keyValuePair);
-		Node<Key, Value>* removeHelper(Node<Key, Value>* root, const Key& key);
-		int isBalancedHelper(Node<Key, Value>* curr) const;
-    static Node<Key, Value>* successor(Node<Key, Value>* current); 
-		void clearHelper(Node<Key, Value>* n);
+    // Constructor/destructor.
+    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    template<typename... Args>
+    AVLNode(AVLNode<Key, Value>* parent, Args&&... args);
+    ~AVLNode();
+
+    // Getter/setter for the node's height.
+    int8_t getBalance () const;
+    void setBalance (int8_t balance);
+    void updateBalance(int8_t diff);
+    void setSubtreeHeights(int leftHeight, int rightHeight);
+
+    // Getters for parent, left, and right. These need to be redefined since they
+    // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
+    // for more information.
+    AVLNode<Key, Value>* getParent() const;
+    AVLNode<Key, Value>* getLeft() const;
+    AVLNode<Key, Value>* getRight() const;
 
 protected:
-    Node<Key, Value>* root_;
-    // You should not need other data members
+    int8_t balance_;    // effectively a signed char
 };
 
 /*
---------------------------------------------------------------
-Begin implementations for the BinarySearchTree::iterator class.
----------------------------------------------------------------
+  -------------------------------------------------
+  Begin implementations for the AVLNode class.
+  -------------------------------------------------
 */
 
 /**
-* Explicit constructor that initializes an iterator with a given node pointer.
+* An explicit constructor to initialize the elements by calling the base class constructor
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
+AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
+    Node<Key, Value>(key, value, parent), balance_(0)
 {
-    // TODO / DONE?
-	current_ = ptr;
+
 }
 
 /**
-* A default constructor that initializes the iterator to NULL.
+* A constructor that builds the item in place from args.
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() 
+template<typename... Args>
+AVLNode<Key, Value>::AVLNode(AVLNode<Key, Value>* parent, Args&&... args) :
+    Node<Key, Value>(parent, std::forward<Args>(args)...), balance_(0)
 {
-    // TODO / DONE?
-	current_ = NULL;
+
 }
 
 /**
-* Provides access to the item.
+* A destructor which does nothing.
 */
 template<class Key, class Value>
-std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+AVLNode<Key, Value>::~AVLNode()
 {
-    return current_->getItem();
+
 }
 
 /**
-* Provides access to the address of the item.
+* A getter for the balance of a AVLNode.
 */
 template<class Key, class Value>
-std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+int8_t AVLNode<Key, Value>::getBalance() const
 {
-    return &(current_->getItem());
+    return balance_;
 }
 
 /**
-* Checks if 'this' iterator's internals have the same value
-* as 'rhs'
+* A setter for the balance of a AVLNode.
 */
 template<class Key, class Value>
-bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+void AVLNode<Key, Value>::setBalance(int8_t balance)
 {
-	
-    // TODO 
-	return (this->current_ == rhs.current_);
+    balance_ = balance;
 }
 
 /**
-* Checks if 'this' iterator's internals have a different value
-* as 'rhs'
+* Adds diff to the balance of a AVLNode.
 */
 template<class Key, class Value>
-bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+void AVLNode<Key, Value>::updateBalance(int8_t diff)
 {
-    // TODO
-	return (this->current_ != rhs.current_);
+    balance_ += diff;
+}
 
+/**
+* Sets the balance from the subtree heights when a tree is built in bulk.
+*/
+template<class Key, class Value>
+void AVLNode<Key, Value>::setSubtreeHeights(int leftHeight, int rightHeight)
+{
+    balance_ = rightHeight - leftHeight;
 }
 
+/**
+* A redefined getter for the parent since a static_cast is necessary to make sure
+* that our node is a AVLNode.  The cast is resolved at compile time.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
+{
+    return static_cast<AVLNode<Key, Value>*>(this->parent_);
+}
 
 /**
-* Advances the iterator's location using an in-order sequencing
+* Redefined for the same reasons as above.
 */
 template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
+AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
 {
-    // TODO
-	
-	current_ = successor(current_);
-	return *this;
+    return static_cast<AVLNode<Key, Value>*>(this->left_);
 }
 
+/**
+* Redefined for the same reasons as above.
+*/
 template<class Key, class Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current) 
+AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 {
-	//if right child exists, successor is left most node on right subtree 
-	if (current->getRight() != NULL) {
-		Node<Key, Value>* leftMost = current->getRight();
-		while (leftMost->getLeft() != NULL) {
-			leftMost = leftMost->getLeft();
-		} 
-		return leftMost;
-	} else {
-		// first node who is a left child of his parent…
-		//that parent is the successor
-		Node<Key, Value>* c = current;
-		Node<Key, Value>* p = c->getParent();
-		while (p != NULL) {
-			//check if this node is a left child of its parent  
-			if (p->getLeft() != NULL) {
-				if (p ->getLeft() == c) return p;
-			} 
-			c = p;
-			p = p->getParent();
-			
-		}
-		// get to root - no successor 
-		if (p == NULL) {
-			return nullptr;
-		}
-	}
-	return nullptr;
+    return static_cast<AVLNode<Key, Value>*>(this->right_);
 }
 
 
 /*
--------------------------------------------------------------
-End implementations for the BinarySearchTree::iterator class.
--------------------------------------------------------------
+  -----------------------------------------------
+  End implementations for the AVLNode class.
+  -----------------------------------------------
 */
 
-/*
------------------------------------------------------
-Begin implementations for the BinarySearchTree class.
------------------------------------------------------
-*/
+/**
+ * A node that also stores the number of nodes in its subtree, so that a
+ * tree built from it can answer select() and rank() in O(log n).
+ * BaseNode is Node or AVLNode, e.g.
+ *     AVLTree<Key, Value, SizedNode<AVLNode<Key, Value> > >
+ * Trees keep the sizes up to date through SubtreeSize.
+ */
+template <typename BaseNode>
+class SizedNode : public BaseNode
+{
+public:
+    template <typename Key, typename Value>
+    SizedNode(const Key& key, const Value& value, SizedNode<BaseNode>* parent);
+    template <typename... Args>
+    SizedNode(SizedNode<BaseNode>* parent, Args&&... args);
+
+    SizedNode<BaseNode>* getParent() const;
+    SizedNode<BaseNode>* getLeft() const;
+    SizedNode<BaseNode>* getRight() const;
+
+    std::size_t getSize() const;
+    void setSize(std::size_t size);
+    static std::size_t sizeOf(const SizedNode<BaseNode>* n);
+
+    static const bool TRACKS_SIZE = true;
+
+protected:
+    std::size_t size_;
+};
 
 /**
-* Default constructor for a BinarySearchTree, which sets the root to NULL.
+* Constructs a leaf, whose subtree is just itself.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+template <typename BaseNode>
+template <typename Key, typename Value>
+SizedNode<BaseNode>::SizedNode(const Key& key, const Value& value, SizedNode<BaseNode>* parent) :
+    BaseNode(key, value, parent), size_(1)
 {
-    // TODO / DONE?
-		root_ = NULL;
+
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* Constructs a leaf with its item built in place from args.
+*/
+template <typename BaseNode>
+template <typename... Args>
+SizedNode<BaseNode>::SizedNode(SizedNode<BaseNode>* parent, Args&&... args) :
+    BaseNode(parent, std::forward<Args>(args)...), size_(1)
 {
-    // TODO / DONE 
-	clear();
 
 }
 
 /**
- * Returns true if tree is empty
+* Getters for parent, left, and right redefined to return SizedNodes.
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template <typename BaseNode>
+SizedNode<BaseNode>* SizedNode<BaseNode>::getParent() const
 {
-    return root_ == NULL;
+    return static_cast<SizedNode<BaseNode>*>(BaseNode::getParent());
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+template <typename BaseNode>
+SizedNode<BaseNode>* SizedNode<BaseNode>::getLeft() const
 {
-    printRoot(root_);
-    std::cout << "\n";
+    return static_cast<SizedNode<BaseNode>*>(BaseNode::getLeft());
+}
+
+template <typename BaseNode>
+SizedNode<BaseNode>* SizedNode<BaseNode>::getRight() const
+{
+    return static_cast<SizedNode<BaseNode>*>(BaseNode::getRight());
 }
 
 /**
-* Returns an iterator to the "smallest" item in the tree
+* A getter for the number of nodes in this node's subtree.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template <typename BaseNode>
+std::size_t SizedNode<BaseNode>::getSize() const
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
-    return begin;
+    return size_;
 }
 
 /**
-* Returns an iterator whose value means INVALID
+* A setter for the subtree size.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template <typename BaseNode>
+void SizedNode<BaseNode>::setSize(std::size_t size)
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
-    return end;
+    size_ = size;
 }
 
 /**
-* Returns an iterator to the item with the given key, k
-* or the end iterator if k does not exist in the tree
+* The subtree size of n, treating NULL as an empty subtree.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template <typename BaseNode>
+std::size_t SizedNode<BaseNode>::sizeOf(const SizedNode<BaseNode>* n)
 {
-    Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
-    return it;
+    return n == NULL ? 0 : n->size_;
 }
 
 /**
- * @precondition The key exists in the map
- * Returns the value associated with the key
+ * A tree's item count, which size() may fill in from a const call.  Every
+ * access is a relaxed atomic load or store, so const calls on different
+ * threads can fill it in together without a data race, yet each access
+ * still compiles to a plain move.  It is only ever written by one thread
+ * at a time or with the same value, so load-then-store increments are
+ * enough.
  */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
-{
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
-}
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+class CachedSize
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
-}
+public:
+    CachedSize(std::size_t n = 0) : n_(n) { }
+    CachedSize(const CachedSize& other) : n_(std::size_t(other)) { }
+
+    CachedSize& operator=(const CachedSize& other) { return *this = std::size_t(other); }
+    CachedSize& operator=(std::size_t n)
+    {
+        n_.store(n, std::memory_order_relaxed);
+        return *this;
+    }
+    operator std::size_t() const { return n_.load(std::memory_order_relaxed); }
+    CachedSize& operator++() { return *this = std::size_t(*this) + 1; }
+    CachedSize& operator--() { return *this = std::size_t(*this) - 1; }
+
+private:
+    std::atomic<std::size_t> n_;
+};
 
 /**
-* An insert method to insert into a Binary Search Tree.
-* The tree will not remain balanced when inserting.
-* Recall: If key is already in the tree, you should 
-* overwrite the current value with the updated value.
-*/
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+ * Keeps SizedNode subtree sizes up to date.  Trees call it whenever the
+ * links below a node change; for node types that do not track sizes,
+ * SubtreeSize<false>, every call compiles to nothing.
+ */
+template <bool Tracked>
+struct SubtreeSize
 {
-	// TODO / DONE
-	root_ = insertHelper(root_, keyValuePair);
-}
+    template <typename NodeT> static void update(NodeT*) { }
+    template <typename NodeT> static void updatePath(NodeT*) { }
+    template <typename NodeT> static void swap(NodeT*, NodeT*) { }
+    template <typename NodeT> static std::size_t count(NodeT*, std::size_t unknown) { return unknown; }
+    template <typename NodeT> static bool check(NodeT*) { return true; }
+};
 
-template<class Key, class Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::insertHelper(Node<Key, Value>* root, const std::pair<const Key, Value>& keyValuePair) 
+template <>
+struct SubtreeSize<true>
 {
-	if (root == NULL) {
-		return new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
-	}
+    // Recomputes n's size from its children
+    template <typename NodeT>
+    static void update(NodeT* n)
+    {
+        n->setSize(1 + NodeT::sizeOf(n->getLeft()) + NodeT::sizeOf(n->getRight()));
+    }
 
-	if (root->getKey() == keyValuePair.first) {
-		// replace 
-		root->setValue(keyValuePair.second);
-		return root;
-	}
-	//recurse down 
-	if (keyValuePair.first < root->getKey()) {
-		// go to left 
-		root->setLeft(insertHelper(root->getLeft(), keyValuePair));
-		root->getLeft()->setParent(root);
-		
-	} else {
-		// go to right 
-		root->setRight(insertHelper(root->getRight(), keyValuePair));
-		root->getRight()->setParent(root);
-	}
-	return root;
-}
+    // Recomputes n and every ancestor of n, bottom up
+    template <typename NodeT>
+    static void updatePath(NodeT* n)
+    {
+        for (; n != NULL; n = n->getParent()) {
+            update(n);
+        }
+    }
+
+    // Exchanges sizes after two nodes have exchanged positions
+    template <typename NodeT>
+    static void swap(NodeT* n1, NodeT* n2)
+    {
+        std::size_t size = n1->getSize();
+        n1->setSize(n2->getSize());
+        n2->setSize(size);
+    }
+
+    // Number of nodes in the subtree at n
+    template <typename NodeT>
+    static std::size_t count(NodeT* n, std::size_t)
+    {
+        return NodeT::sizeOf(n);
+    }
 
+    // True if n's stored size agrees with its children's
+    template <typename NodeT>
+    static bool check(NodeT* n)
+    {
+        return n->getSize() == 1 + NodeT::sizeOf(n->getLeft()) + NodeT::sizeOf(n->getRight());
+    }
+};
 
 /**
-* A remove method to remove a specific key from a Binary Search Tree.
-* Recall: The writeup specifies that if a node has 2 children you
-* should swap with the predecessor and then remove.
+* A templated unbalanced binary search tree.
+* Compare orders the keys as for std::map; a transparent comparator such as
+* std::less<> also allows lookups by any key type it can compare, e.g. a
+* std::string_view into a tree of std::string.  Each node visited costs one
+* call to Compare: searches descend on "less than" alone and test for an
+* equal key once, at the end.
+* NodeT is the concrete node type, so every link the tree follows is a plain,
+* statically typed load.  It defaults to AVLNode, as for AVLTree, so that
+* code taking a BinarySearchTree<Key, Value>& accepts an AVLTree<Key, Value>
+* too; a plain tree that wants the smallest node names Node<Key, Value>.
+* Alloc supplies storage for NodeT: the default NodePool carves nodes from
+* slabs, while std::allocator gives one new per node.
 */
-//here
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename NodeT = AVLNode<Key, Value>, typename Alloc = NodePool<NodeT> >
+class BinarySearchTree : protected StatsCounter<BST_STATS != 0>
 {
-	// TODO / DONE?
-	Node<Key, Value>* toDelete = internalFind(key);
-	if (toDelete != NULL) {
-		if (toDelete->getRight() != NULL && toDelete->getLeft() != NULL) {
-			// 2 children exist. swap toDelete w its predecessor 
-			//find predecessor 
-			Node<Key, Value>* pred = predecessor(toDelete);
-			nodeSwap(toDelete, pred);
-		} 
+public:
+    BinarySearchTree();
+    explicit BinarySearchTree(const Compare& comp);
+    template<typename ForwardIt>
+    BinarySearchTree(ForwardIt first, ForwardIt last, const Compare& comp = Compare());
+    BinarySearchTree(BinarySearchTree&& other);
+    BinarySearchTree& operator=(BinarySearchTree&& other);
+    virtual ~BinarySearchTree();
+    template<typename ForwardIt>
+    void assign(ForwardIt first, ForwardIt last);
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    void insert(std::pair<Key, Value>&& keyValuePair);
+    template<typename P>
+    typename std::enable_if<std::is_constructible<std::pair<Key, Value>, P&&>::value &&
+        !std::is_same<typename std::decay<P>::type, std::pair<const Key, Value> >::value>::type
+    insert(P&& keyValuePair);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator, bool> try_emplace(Key&& key, Args&&... args);
+    virtual void remove(const Key& key);
+    void clear();
+    virtual bool isBalanced() const;
+    virtual void validate() const;
+    void print() const;
+    bool empty() const;
+    std::size_t size() const;
+    TreeStats stats() const;
+    void resetStats();
 
-		// leaf node, just delete the node
-		if ((toDelete->getRight() == NULL) && (toDelete->getLeft() == NULL)) {
-			// check if head pointer 
-			if (toDelete == root_) {
-				root_ = NULL;
-			} else {
-				//update parent pointer 
-				if (toDelete->getParent()->getRight() == toDelete) {
-					// toDelete's a right child 
-					toDelete->getParent()->setRight(NULL);
-				} else {
-					// toDelete's a left child 
-					toDelete->getParent()->setLeft(NULL);
-				}
-			}
-			delete toDelete;
-		} else {
-			if (toDelete->getRight() != NULL) {
-				// only right child exists
-				Node<Key, Value>* rChild = toDelete->getRight();
-				if (toDelete == root_) {
-					root_= rChild;
-					rChild->setParent(NULL);
-				} else {
-					Node<Key, Value>* parent = toDelete->getParent();
-					if (parent->getRight() == toDelete) {
-						//todelete is a right child of parent 
-						parent->setRight(rChild);
+    template<typename PPKey, typename PPValue>
+    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
+public:
+    class const_iterator;
+
+    /**
+    * An internal iterator class for traversing the contents of the BST.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class BinarySearchTree<Key, Value, Compare, NodeT, Alloc>;
+        iterator(NodeT* ptr, const BinarySearchTree* tree);
+        NodeT *current_;
+        // The tree, for stepping back from end()
+        const BinarySearchTree* tree_;
+    };
+
+    /**
+    * An iterator that gives read-only access to the items, as returned
+    * by begin() and end() on a const tree.  Any iterator converts to one.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const iterator& it);
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    protected:
+        friend class BinarySearchTree<Key, Value, Compare, NodeT, Alloc>;
+        const_iterator(NodeT* ptr, const BinarySearchTree* tree);
+        NodeT *current_;
+        const BinarySearchTree* tree_;
+    };
+
+    /**
+    * A view of the items with keys in a half-open range [lo, hi),
+    * usable in a range-based for loop.  It is an iterator or a
+    * const_iterator, as range() is called on a tree or a const tree.
+    */
+    template<typename It>
+    class basic_range_view
+    {
+    public:
+        basic_range_view(const It& first, const It& last);
+
+        It begin() const;
+        It end() const;
+
+    protected:
+        It first_;
+        It last_;
+    };
+
+    typedef basic_range_view<iterator> range_view;
+    typedef basic_range_view<const_iterator> const_range_view;
+
+    /**
+    * An in-order cursor that keeps the path of ancestors still to visit on
+    * an explicit stack instead of climbing parent links, so each step is
+    * O(1) amortized and touches every node once.
+    */
+    class cursor
+    {
+    public:
+        cursor();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const cursor& rhs) const;
+        bool operator!=(const cursor& rhs) const;
+
+        cursor& operator++();
+
+    protected:
+        friend class BinarySearchTree<Key, Value, Compare, NodeT, Alloc>;
+        cursor(NodeT* root, std::size_t depth);
+        void pushLeft(NodeT* n);
+        std::vector<NodeT*> path_;
+    };
+
+    /**
+    * The whole tree in order, walked with a cursor; for range-based for
+    * loops over large trees.
+    */
+    class cursor_view
+    {
+    public:
+        cursor_view(NodeT* root, std::size_t depth);
+
+        cursor begin() const;
+        cursor end() const;
+
+    protected:
+        NodeT* root_;
+        std::size_t depth_;
+    };
+
+public:
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin();
+    reverse_iterator rend();
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator rend() const;
+    const_reverse_iterator crbegin() const;
+    const_reverse_iterator crend() const;
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key);
+    const_iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key);
+    const_iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key);
+    std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+    range_view range(const Key& lo, const Key& hi);
+    const_range_view range(const Key& lo, const Key& hi) const;
+    cursor_view inorder() const;
+    Compare key_comp() const;
+    FrozenTree<Key, Value, Compare> freeze() const;
+
+    // Heterogeneous lookup, for transparent comparators only
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator find(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator lower_bound(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator lower_bound(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator upper_bound(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator upper_bound(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    std::pair<iterator, iterator> equal_range(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    std::pair<const_iterator, const_iterator> equal_range(const K& key) const;
+
+    // Order statistics; NodeT must be a SizedNode
+    iterator select(std::size_t k);
+    const_iterator select(std::size_t k) const;
+    std::size_t rank(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    // Mandatory helper functions
+    template<typename K>
+    NodeT* internalFind(const K& k) const;
+    template<typename K>
+    NodeT* internalLowerBound(const K& k) const;
+    template<typename K>
+    NodeT* internalUpperBound(const K& k) const;
+    NodeT* internalSelect(std::size_t k) const;
+    NodeT *getSmallestNode() const;
+    static NodeT* predecessor(NodeT* current, const StatsCounter<BST_STATS != 0>* stats = NULL);
+    // Note:  static means these functions don't have a "this" pointer
+    //        and instead just use the input argument.
+
+    // Provided helper functions
+    virtual void printRoot (NodeT *r) const;
+    virtual void nodeSwap( NodeT* n1, NodeT* n2) ;
+
+    // Add helper functions here
+		NodeT* getLargestNode() const;
+		NodeT* lastNode() const;
+		iterator iteratorAt(NodeT* n) const;
+		NodeT* findSlot(const Key& key, NodeT*& parent, bool& left) const;
+		void linkLeaf(NodeT* parent, bool left, NodeT* n);
+		virtual void leafAdded(NodeT* n);
+		virtual void keyFound(NodeT* n);
+		int isBalancedHelper(NodeT* curr) const;
+    static NodeT* successor(NodeT* current, const StatsCounter<BST_STATS != 0>* stats = NULL);
+		void clearHelper(NodeT* n);
+		template<typename ForwardIt>
+		NodeT* buildBalanced(ForwardIt& it, std::size_t n, NodeT* parent, int& height);
+		template<typename... Args>
+		NodeT* createNode(NodeT* parent, Args&&... args);
+		void destroyNode(NodeT* n);
+		void relinked();
+		void removing(NodeT* n);
+		static std::size_t countNodes(NodeT* root);
+
+protected:
+    typedef std::allocator_traits<Alloc> NodeAllocTraits;
+    typedef StatsCounter<BST_STATS != 0> Stats;
+
+    template<typename A, typename B>
+    bool keyLess(const A& a, const B& b) const;
+
+    // The operation counters.  The tree inherits them rather than holding
+    // a member so that, with BST_STATS off, the empty StatsCounter<false>
+    // takes no space.
+    Stats& counter() { return *this; }
+    const Stats& counter() const { return *this; }
+
+    // size_ of a tree whose nodes were moved in wholesale (e.g. by
+    // AVLTree::split) and have not been counted yet; see size()
+    static const std::size_t UNKNOWN_SIZE = static_cast<std::size_t>(-1);
+
+    NodeT* root_;
+    mutable CachedSize size_;
+    // Node with the largest key, or NULL when empty; see lastNode()
+    NodeT* largest_;
+    Alloc alloc_;
+    Compare comp_;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the BinarySearchTree::iterator class.
+---------------------------------------------------------------
+*/
+
+/**
+* Explicit constructor that initializes an iterator with a given node pointer.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::iterator(NodeT *ptr, const BinarySearchTree* tree)
+{
+	current_ = ptr;
+	tree_ = tree;
+}
+
+/**
+* A default constructor that initializes the iterator to NULL.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::iterator() 
+{
+	current_ = NULL;
+	tree_ = NULL;
+}
+
+/**
+* Provides access to the item.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+std::pair<const Key,Value> &
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::operator*() const
+{
+    return current_->getItem();
+}
+
+/**
+* Provides access to the address of the item.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+std::pair<const Key,Value> *
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::operator->() const
+{
+    return &(current_->getItem());
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value
+* as 'rhs'
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator& rhs) const
+{
+	
+	return (this->current_ == rhs.current_);
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value
+* as 'rhs'
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator& rhs) const
+{
+	return (this->current_ != rhs.current_);
+
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator& rhs) const
+{
+    return rhs == *this;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator& rhs) const
+{
+    return rhs != *this;
+}
+
+
+/**
+* Advances the iterator's location using an in-order sequencing
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator&
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::operator++()
+{
+	
+	current_ = successor(current_, &tree_->counter());
+	return *this;
+}
+
+/**
+* Advances the iterator, returning a copy of it from before the step.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::operator++(int)
+{
+    iterator old = *this;
+    ++(*this);
+    return old;
+}
+
+/**
+* Steps back to the previous item in order.  Stepping back from end()
+* lands on the largest item, which the tree keeps cached.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator&
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::operator--()
+{
+	if (current_ == NULL) {
+		current_ = tree_->lastNode();
+	} else {
+		current_ = predecessor(current_, &tree_->counter());
+	}
+	return *this;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator::operator--(int)
+{
+    iterator old = *this;
+    --(*this);
+    return old;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::successor(NodeT* current, const Stats* stats) 
+{
+	//if right child exists, successor is left most node on right subtree 
+	if (current->getRight() != NULL) {
+		NodeT* leftMost = current->getRight();
+		if (stats != NULL) stats->count(&TreeStats::iteratorSteps);
+		while (leftMost->getLeft() != NULL) {
+			leftMost = leftMost->getLeft();
+			if (stats != NULL) stats->count(&TreeStats::iteratorSteps);
+		} 
+		return leftMost;
+	} else {
+		// first node who is a left child of his parent…
+		//that parent is the successor
+		NodeT* c = current;
+		NodeT* p = c->getParent();
+		while (p != NULL) {
+			if (stats != NULL) stats->count(&TreeStats::iteratorSteps);
+			//check if this node is a left child of its parent  
+			if (p->getLeft() != NULL) {
+				if (p ->getLeft() == c) return p;
+			} 
+			c = p;
+			p = p->getParent();
+			
+		}
+		// get to root - no successor 
+		if (p == NULL) {
+			return nullptr;
+		}
+	}
+	return nullptr;
+}
+
+
+/*
+-------------------------------------------------------------
+End implementations for the BinarySearchTree::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+---------------------------------------------------------------------
+Begin implementations for the BinarySearchTree::const_iterator class.
+---------------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::const_iterator(NodeT *ptr, const BinarySearchTree* tree) :
+    current_(ptr),
+    tree_(tree)
+{
+
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::const_iterator() :
+    current_(NULL),
+    tree_(NULL)
+{
+
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::const_iterator(const iterator& it) :
+    current_(it.current_),
+    tree_(it.tree_)
+{
+
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+const std::pair<const Key,Value> &
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::operator*() const
+{
+    return current_->getItem();
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+const std::pair<const Key,Value> *
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::operator->() const
+{
+    return &(current_->getItem());
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator&
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::operator++()
+{
+    current_ = successor(current_, &tree_->counter());
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::operator++(int)
+{
+    const_iterator old = *this;
+    ++(*this);
+    return old;
+}
+
+/**
+* See iterator::operator--().
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator&
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::operator--()
+{
+    current_ = (current_ == NULL) ? tree_->lastNode() : predecessor(current_, &tree_->counter());
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator::operator--(int)
+{
+    const_iterator old = *this;
+    --(*this);
+    return old;
+}
+
+/*
+-------------------------------------------------------------------
+End implementations for the BinarySearchTree::const_iterator class.
+-------------------------------------------------------------------
+*/
+
+/**
+* Constructs a view over the iterator range [first, last).
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename It>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::basic_range_view<It>::basic_range_view(
+    const It& first, const It& last) :
+    first_(first),
+    last_(last)
+{
+
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename It>
+It BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::basic_range_view<It>::begin() const
+{
+    return first_;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename It>
+It BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::basic_range_view<It>::end() const
+{
+    return last_;
+}
+
+/**
+* An exhausted cursor, equal to cursor_view::end().
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor::cursor()
+{
+
+}
+
+/**
+* Starts at the smallest node under root, with room for depth ancestors.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor::cursor(NodeT* root, std::size_t depth)
+{
+    path_.reserve(depth);
+    pushLeft(root);
+}
+
+/**
+* Pushes n and its chain of left children.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor::pushLeft(NodeT* n)
+{
+    for (; n != NULL; n = n->getLeft()) {
+        path_.push_back(n);
+    }
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+std::pair<const Key,Value>& BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor::operator*() const
+{
+    return path_.back()->getItem();
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+std::pair<const Key,Value>* BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor::operator->() const
+{
+    return &(path_.back()->getItem());
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor::operator==(const cursor& rhs) const
+{
+    if (path_.empty() || rhs.path_.empty()) {
+        return path_.empty() == rhs.path_.empty();
+    }
+    return path_.back() == rhs.path_.back();
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor::operator!=(const cursor& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* The next node is the smallest in the right subtree, or else the
+* nearest ancestor still on the stack.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor&
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor::operator++()
+{
+    NodeT* n = path_.back();
+    path_.pop_back();
+    pushLeft(n->getRight());
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor_view::cursor_view(NodeT* root, std::size_t depth) :
+    root_(root),
+    depth_(depth)
+{
+
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor_view::begin() const
+{
+    return cursor(root_, depth_);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor_view::end() const
+{
+    return cursor();
+}
+
+/*
+-----------------------------------------------------
+Begin implementations for the BinarySearchTree class.
+-----------------------------------------------------
+*/
+
+/**
+* Default constructor for a BinarySearchTree, which sets the root to NULL.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::BinarySearchTree() 
+{
+		root_ = NULL;
+		size_ = 0;
+		largest_ = NULL;
+}
+
+/**
+* Constructs an empty tree ordered by comp.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::BinarySearchTree(const Compare& comp) :
+    comp_(comp)
+{
+		root_ = NULL;
+		size_ = 0;
+		largest_ = NULL;
+}
+
+/**
+* Builds a height-balanced tree from a range sorted by key with no
+* duplicate keys, in linear time.  See assign().
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename ForwardIt>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::BinarySearchTree(ForwardIt first, ForwardIt last, const Compare& comp) :
+    comp_(comp)
+{
+		root_ = NULL;
+		size_ = 0;
+		largest_ = NULL;
+		assign(first, last);
+}
+
+/**
+* Takes over other's nodes, leaving other empty.  The allocator is copied,
+* so the nodes are still freed through the pool that made them.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::BinarySearchTree(BinarySearchTree&& other) :
+    root_(other.root_),
+    size_(other.size_),
+    largest_(other.largest_),
+    alloc_(other.alloc_),
+    comp_(other.comp_)
+{
+		other.root_ = NULL;
+		other.size_ = 0;
+		other.largest_ = NULL;
+}
+
+/**
+* Clears this tree and takes over other's nodes, leaving other empty.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>&
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::operator=(BinarySearchTree&& other)
+{
+		if (this != &other) {
+			clear();
+			root_ = other.root_;
+			size_ = other.size_;
+			largest_ = other.largest_;
+			alloc_ = other.alloc_;
+			comp_ = other.comp_;
+			other.root_ = NULL;
+			other.size_ = 0;
+			other.largest_ = NULL;
+		}
+		return *this;
+}
+
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::~BinarySearchTree()
+{
+	clear();
+
+}
+
+/**
+ * Returns true if tree is empty
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+bool BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::empty() const
+{
+    return root_ == NULL;
+}
+
+/**
+ * Returns the number of items in the tree, in O(1).  The one exception is
+ * the first call after a split on a tree without subtree sizes (or a join
+ * of such a tree), which counts the nodes once: a split only relinks
+ * O(log n) nodes and does not learn how many went each way.  Concurrent
+ * const calls may each count, but they store the same number through
+ * CachedSize, so they do not race.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::size() const
+{
+    if (size_ == UNKNOWN_SIZE) {
+        size_ = countNodes(root_);
+    }
+    return size_;
+}
+
+/**
+* The tree's operation counts; all zero unless built with BST_STATS.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+TreeStats BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::stats() const
+{
+    return counter().get();
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::resetStats()
+{
+    counter().reset();
+}
+
+/**
+* comp_(a, b), counted as a comparison.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename A, typename B>
+bool BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::keyLess(const A& a, const B& b) const
+{
+    counter().count(&TreeStats::comparisons);
+    return comp_(a, b);
+}
+
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::print() const
+{
+    printRoot(root_);
+    std::cout << "\n";
+}
+
+/**
+* Returns an iterator to the "smallest" item in the tree
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::begin()
+{
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator begin(getSmallestNode(), this);
+    return begin;
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::end()
+{
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator end(NULL, this);
+    return end;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::begin() const
+{
+    return const_iterator(getSmallestNode(), this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::end() const
+{
+    return const_iterator(NULL, this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cbegin() const
+{
+    return begin();
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cend() const
+{
+    return end();
+}
+
+/**
+* Returns a reverse iterator to the largest item.  It starts from the
+* cached largest node, so a reverse scan starts in O(1).
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::reverse_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::rbegin()
+{
+    return reverse_iterator(end());
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::reverse_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::rend()
+{
+    return reverse_iterator(begin());
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::rbegin() const
+{
+    return const_reverse_iterator(end());
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::rend() const
+{
+    return const_reverse_iterator(begin());
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::crbegin() const
+{
+    return rbegin();
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::crend() const
+{
+    return rend();
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree.
+* On a const tree the iterator is a const_iterator, as for the other
+* lookups below.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::find(const Key & k)
+{
+    NodeT *curr = internalFind(k);
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator it(curr, this);
+    return it;
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::find(const Key & k) const
+{
+    return const_iterator(internalFind(k), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than k,
+* or the end iterator if there is none.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::lower_bound(const Key & k)
+{
+    return iterator(internalLowerBound(k), this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::lower_bound(const Key & k) const
+{
+    return const_iterator(internalLowerBound(k), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than k,
+* or the end iterator if there is none.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::upper_bound(const Key & k)
+{
+    return iterator(internalUpperBound(k), this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::upper_bound(const Key & k) const
+{
+    return const_iterator(internalUpperBound(k), this);
+}
+
+/**
+* Returns a copy of the comparator that orders the keys.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+Compare BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+* Copies the tree into an immutable FrozenTree for read-only use, with
+* cache-friendly lookups and iteration.  O(n); the tree is unchanged.
+* Only callers that include frozen_tree.h can use it.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+FrozenTree<Key, Value, Compare> BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::freeze() const
+{
+    return FrozenTree<Key, Value, Compare>(begin(), size(), comp_);
+}
+
+/**
+* Heterogeneous versions of find, lower_bound, upper_bound and equal_range.
+* They take any key type the transparent comparator can compare with Key,
+* so no temporary Key is constructed.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::find(const K & k)
+{
+    return iterator(internalFind(k), this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::find(const K & k) const
+{
+    return const_iterator(internalFind(k), this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::lower_bound(const K & k)
+{
+    return iterator(internalLowerBound(k), this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::lower_bound(const K & k) const
+{
+    return const_iterator(internalLowerBound(k), this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::upper_bound(const K & k)
+{
+    return iterator(internalUpperBound(k), this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::upper_bound(const K & k) const
+{
+    return const_iterator(internalUpperBound(k), this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename K, typename C, typename>
+std::pair<typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator,
+          typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::equal_range(const K & k)
+{
+    return std::make_pair(iterator(internalLowerBound(k), this), iterator(internalUpperBound(k), this));
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename K, typename C, typename>
+std::pair<typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator,
+          typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::equal_range(const K & k) const
+{
+    return std::make_pair(const_iterator(internalLowerBound(k), this), const_iterator(internalUpperBound(k), this));
+}
+
+/**
+* Returns the range of items with key k: [lower_bound(k), upper_bound(k)).
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator,
+          typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::equal_range(const Key & k)
+{
+    return std::make_pair(lower_bound(k), upper_bound(k));
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator,
+          typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::equal_range(const Key & k) const
+{
+    return std::make_pair(lower_bound(k), upper_bound(k));
+}
+
+/**
+* Returns a view of the items with keys in [lo, hi).  Finding the ends
+* costs O(log n) and walking the k items in between O(k).
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::range_view
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::range(const Key & lo, const Key & hi)
+{
+    if (!keyLess(lo, hi)) {
+        return range_view(end(), end());
+    }
+    return range_view(lower_bound(lo), lower_bound(hi));
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_range_view
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::range(const Key & lo, const Key & hi) const
+{
+    if (!keyLess(lo, hi)) {
+        return const_range_view(end(), end());
+    }
+    return const_range_view(lower_bound(lo), lower_bound(hi));
+}
+
+/**
+* Returns a view of the whole tree for a cursor walk.  The stack is
+* sized from the height of the left spine, which for a balanced tree is
+* close to the whole height.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::cursor_view
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::inorder() const
+{
+    std::size_t depth = 0;
+    for (NodeT* n = root_; n != NULL; n = n->getLeft()) {
+        ++depth;
+    }
+    return cursor_view(root_, 2 * depth);
+}
+
+/**
+* Returns an iterator to the k-th smallest item (counting from 0), or the
+* end iterator if k >= size().  O(log n); requires a SizedNode tree.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::select(std::size_t k)
+{
+    return iterator(internalSelect(k), this);
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::select(std::size_t k) const
+{
+    return const_iterator(internalSelect(k), this);
+}
+
+/**
+* The node with the k-th smallest key, or NULL; see select().
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::internalSelect(std::size_t k) const
+{
+    NodeT* curr = root_;
+    while (curr != NULL) {
+        counter().count(&TreeStats::nodesVisited);
+        std::size_t leftSize = NodeT::sizeOf(curr->getLeft());
+        if (k < leftSize) {
+            curr = curr->getLeft();
+        } else if (k == leftSize) {
+            break;
+        } else {
+            k -= leftSize + 1;
+            curr = curr->getRight();
+        }
+    }
+    return curr;
+}
+
+/**
+* Returns the number of keys less than key.  O(log n); requires a
+* SizedNode tree.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::rank(const Key & key) const
+{
+    std::size_t below = 0;
+    NodeT* curr = root_;
+    while (curr != NULL) {
+        counter().count(&TreeStats::nodesVisited);
+        if (keyLess(curr->getKey(), key)) {
+            below += NodeT::sizeOf(curr->getLeft()) + 1;
+            curr = curr->getRight();
+        } else {
+            curr = curr->getLeft();
+        }
+    }
+    return below;
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+Value& BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::operator[](const Key& key)
+{
+    NodeT *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+Value const & BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::operator[](const Key& key) const
+{
+    NodeT *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/**
+* An insert method to insert into a Binary Search Tree.
+* The tree will not remain balanced when inserting.
+* Recall: If key is already in the tree, you should 
+* overwrite the current value with the updated value.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+	NodeT* parent;
+	bool left;
+	NodeT* existing = findSlot(keyValuePair.first, parent, left);
+	if (existing != NULL) {
+		// replace
+		existing->setValue(keyValuePair.second);
+		keyFound(existing);
+		return;
+	}
+	linkLeaf(parent, left, createNode(parent, keyValuePair.first, keyValuePair.second));
+}
+
+/**
+* Inserts a pair by moving its key and value into a new node.  If the key
+* is already in the tree, the new value is moved over the current one.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+	NodeT* parent;
+	bool left;
+	NodeT* existing = findSlot(keyValuePair.first, parent, left);
+	if (existing != NULL) {
+		existing->setValue(std::move(keyValuePair.second));
+		keyFound(existing);
+		return;
+	}
+	linkLeaf(parent, left, createNode(parent, std::move(keyValuePair.first), std::move(keyValuePair.second)));
+}
+
+/**
+* Inserts any other pair convertible to the item, such as
+* make_pair("key", "value") for string keys, moving from it where it can.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename P>
+typename std::enable_if<std::is_constructible<std::pair<Key, Value>, P&&>::value &&
+    !std::is_same<typename std::decay<P>::type, std::pair<const Key, Value> >::value>::type
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::insert(P&& keyValuePair)
+{
+	insert(std::pair<Key, Value>(std::forward<P>(keyValuePair)));
+}
+
+/**
+* Constructs an item in place from args, as for the pair constructors.
+* If its key is already in the tree, the new value is moved over the
+* current one.  Returns the item and whether a new node was added.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::emplace(Args&&... args)
+{
+	NodeT* n = createNode(NULL, std::forward<Args>(args)...);
+	NodeT* parent;
+	bool left;
+	NodeT* existing = findSlot(n->getKey(), parent, left);
+	if (existing != NULL) {
+		existing->setValue(std::move(n->getValue()));
+		destroyNode(n);
+		keyFound(existing);
+		return std::make_pair(iterator(existing, this), false);
+	}
+	n->setParent(parent);
+	linkLeaf(parent, left, n);
+	return std::make_pair(iterator(n, this), true);
+}
+
+/**
+* Adds key with a value constructed in place from args, unless key is
+* already in the tree, in which case nothing is constructed or changed.
+* Returns the item and whether a new node was added.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::try_emplace(const Key& key, Args&&... args)
+{
+	NodeT* parent;
+	bool left;
+	NodeT* existing = findSlot(key, parent, left);
+	if (existing != NULL) {
+		keyFound(existing);
+		return std::make_pair(iterator(existing, this), false);
+	}
+	NodeT* n = createNode(parent, std::piecewise_construct, std::forward_as_tuple(key),
+		std::forward_as_tuple(std::forward<Args>(args)...));
+	linkLeaf(parent, left, n);
+	return std::make_pair(iterator(n, this), true);
+}
+
+/**
+* As above, moving the key into the new node.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::try_emplace(Key&& key, Args&&... args)
+{
+	NodeT* parent;
+	bool left;
+	NodeT* existing = findSlot(key, parent, left);
+	if (existing != NULL) {
+		keyFound(existing);
+		return std::make_pair(iterator(existing, this), false);
+	}
+	NodeT* n = createNode(parent, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+		std::forward_as_tuple(std::forward<Args>(args)...));
+	linkLeaf(parent, left, n);
+	return std::make_pair(iterator(n, this), true);
+}
+
+/**
+* Looks for key.  Returns its node if it is in the tree; otherwise returns
+* NULL and sets parent to the node a new leaf for key would hang from
+* (NULL for an empty tree) and left to the side it goes on.
+* One comparison per level: the last node we went right at is the only
+* one that can hold key, so it alone is checked for equality at the end.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::findSlot(const Key& key, NodeT*& parent, bool& left) const
+{
+	parent = NULL;
+	left = false;
+	NodeT* candidate = NULL;
+	NodeT* curr = root_;
+	while (curr != NULL) {
+		counter().count(&TreeStats::nodesVisited);
+		parent = curr;
+		left = keyLess(key, curr->getKey());
+		if (left) {
+			curr = curr->getLeft();
+		} else {
+			candidate = curr;
+			curr = curr->getRight();
+		}
+	}
+	if (candidate != NULL && !keyLess(candidate->getKey(), key)) {
+		return candidate;
+	}
+	return NULL;
+}
+
+/**
+* Hangs the new leaf n from parent on the side found by findSlot(), and
+* lets the tree restore its invariants.  Only n and parent are written.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::linkLeaf(NodeT* parent, bool left, NodeT* n)
+{
+	if (parent == NULL) {
+		root_ = n;
+		largest_ = n;
+	} else if (left) {
+		parent->setLeft(n);
+	} else {
+		parent->setRight(n);
+		if (parent == largest_) largest_ = n;
+	}
+	leafAdded(n);
+}
+
+/**
+* Called once a new leaf has been linked in.  The plain BST only has
+* subtree sizes to update; balanced trees rebalance here.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::leafAdded(NodeT* n)
+{
+	SubtreeSize<NodeT::TRACKS_SIZE>::updatePath(n->getParent());
+}
+
+/**
+* Called when an insert or emplace finds its key already at n, after any
+* new value is stored.  Nothing changes shape here; a splay tree splays.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::keyFound(NodeT*)
+{
+
+}
+
+/**
+* A remove method to remove a specific key from a Binary Search Tree.
+* Recall: The writeup specifies that if a node has 2 children you
+* should swap with the predecessor and then remove.
+*/
+//here
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::remove(const Key& key)
+{
+	NodeT* toDelete = internalFind(key);
+	if (toDelete != NULL) {
+		removing(toDelete);
+		if (toDelete->getRight() != NULL && toDelete->getLeft() != NULL) {
+			// 2 children exist. swap toDelete w its predecessor 
+			//find predecessor 
+			NodeT* pred = predecessor(toDelete);
+			nodeSwap(toDelete, pred);
+		} 
+		NodeT* above = toDelete->getParent();
+
+		// leaf node, just delete the node
+		if ((toDelete->getRight() == NULL) && (toDelete->getLeft() == NULL)) {
+			// check if head pointer 
+			if (toDelete == root_) {
+				root_ = NULL;
+			} else {
+				//update parent pointer 
+				if (toDelete->getParent()->getRight() == toDelete) {
+					// toDelete's a right child 
+					toDelete->getParent()->setRight(NULL);
+				} else {
+					// toDelete's a left child 
+					toDelete->getParent()->setLeft(NULL);
+				}
+			}
+			destroyNode(toDelete);
+		} else {
+			if (toDelete->getRight() != NULL) {
+				// only right child exists
+				NodeT* rChild = toDelete->getRight();
+				if (toDelete == root_) {
+					root_= rChild;
+					rChild->setParent(NULL);
+				} else {
+					NodeT* parent = toDelete->getParent();
+					if (parent->getRight() == toDelete) {
+						//todelete is a right child of parent 
+						parent->setRight(rChild);
 					} else parent->setLeft(rChild);
 					rChild->setParent(parent);
 				}
 			} else if (toDelete->getLeft() != NULL){
 				// only left child exists
-				Node<Key, Value>* lChild = toDelete->getLeft();
+				NodeT* lChild = toDelete->getLeft();
 				if (toDelete == root_) {
 					root_ = lChild;
 					lChild->setParent(NULL);
 				} else {
-					Node<Key, Value>* parent = toDelete->getParent();
+					NodeT* parent = toDelete->getParent();
 					if (parent->getRight() == toDelete) {
 						//todelete is a right child of parent 
 						parent->setRight(lChild);
@@ -586,71 +2073,34 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
 					lChild->setParent(parent);
 				}
 			}
-			delete toDelete;
-		}
-	}
-}
-
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::removeHelper(Node<Key, Value>* root, const Key& key)
-{
-	if (root == NULL) {
-		return root;
-	} 
-	// found the one to remove 
-	if (root->getKey() == key) {
-		// leaf node, delete   
-		if ((root->getRight() == NULL) && (root->getLeft() == NULL)) {
-			delete root;
-			return NULL;
-		}
-		if (root->getRight() != NULL && root->getLeft() != NULL) {
-			// 2 children exist. swap root w its predecessor 
-			//find predecessor 
-			Node<Key, Value>* pred = predecessor(root);
-			nodeSwap(root, pred);
-			
-		} else if (root->getRight() != NULL) {
-			// only right child exists
-			Node<Key, Value>* rChild = root->getRight();
-			nodeSwap(root, rChild);
-		} else if (root->getLeft() != NULL){
-			// only left child exists
-			Node<Key, Value>* lChild = root->getLeft();
-			nodeSwap(root, lChild);
-		}
-		remove(root->getKey());
-	} else {
-		if (key < root->getKey()) {
-			root->setLeft(removeHelper(root->getLeft(), key));
-		} else {
-			root->setRight(removeHelper(root->getRight(), key));
+			destroyNode(toDelete);
 		}
+		SubtreeSize<NodeT::TRACKS_SIZE>::updatePath(above);
 	}
-	return root;
 }
 
-template<class Key, class Value>
-Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT*
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::predecessor(NodeT* current, const Stats* stats)
 {
-    // TODO / DONE?
 
 	//if left child exists, pred is right most node of left tree 
 	if (current->getLeft() != NULL) {
 		current = current->getLeft();
+		if (stats != NULL) stats->count(&TreeStats::iteratorSteps);
 		while (current->getRight() != NULL) {
 			current = current->getRight();
+			if (stats != NULL) stats->count(&TreeStats::iteratorSteps);
 		}
 		return current;
 	} else {
 	// go up, find the first node who is a right child of his
   // parent…that parent is the predecessor
 
-		Node<Key, Value>* c = current;
-		Node<Key, Value>* p = c->getParent();
+		NodeT* c = current;
+		NodeT* p = c->getParent();
 		while (p != NULL) {
-			
+			if (stats != NULL) stats->count(&TreeStats::iteratorSteps);
 			//check if this node is a right child of its parent  
 			if (p->getRight() == c) return p;
 
@@ -673,24 +2123,169 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
 */ 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::clear()
 {
-    // TODO / DONE?
-		//post order - left right root 
 		clearHelper(root_);
 		root_ = NULL;
+		size_ = 0;
+		largest_ = NULL;
+		releaseSlabs(alloc_);
 }
 
-template<typename Key, typename Value> 
-void BinarySearchTree<Key, Value>::clearHelper(Node<Key, Value>* n){
-	if (n == NULL) {
-		return;
+/**
+* Destroys the subtree at n in O(n) time and O(1) space, so even a
+* degenerate tree millions of levels deep is safe to free.  Instead of
+* recursing, a left child is rotated up over the top node until the top
+* has no left child; then the top is freed and its right child takes its
+* place.  Each node is rotated up at most once.  Parent links are left
+* stale, as every node is going.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc> 
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::clearHelper(NodeT* n){
+	while (n != NULL) {
+		NodeT* l = n->getLeft();
+		if (l != NULL) {
+			n->setLeft(l->getRight());
+			l->setRight(n);
+			n = l;
+		} else {
+			NodeT* r = n->getRight();
+			destroyNode(n);
+			n = r;
+		}
 	}
-	clearHelper(n->getLeft());
-	clearHelper(n->getRight());
-	delete n;
-	
+}
+
+/**
+* Replaces the contents of the tree with the key/value pairs in
+* [first, last), which must be sorted by key with no duplicate keys.
+* Each node is created once, in order, with its subtree shape fixed
+* up front, so the tree is built in O(n) without any comparisons or
+* rotations and ends up height balanced even for the plain BST.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+template<typename ForwardIt>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::assign(ForwardIt first, ForwardIt last)
+{
+	clear();
+	int height;
+	std::size_t n = std::distance(first, last);
+	root_ = buildBalanced(first, n, NULL, height);
+	largest_ = getLargestNode();
+}
+
+/**
+* Builds a balanced subtree from the next n items of it and returns its
+* root, storing the subtree's height.  The middle item becomes the root,
+* so the two halves differ in size, and height, by at most one.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+template<typename ForwardIt>
+NodeT* BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::buildBalanced(ForwardIt& it, std::size_t n, NodeT* parent, int& height)
+{
+	if (n == 0) {
+		height = 0;
+		return NULL;
+	}
+	int lHeight, rHeight;
+	std::size_t leftCount = (n - 1) / 2;
+	NodeT* left = buildBalanced(it, leftCount, NULL, lHeight);
+	NodeT* root;
+	try {
+		root = createNode(parent, it->first, it->second);
+	} catch (...) {
+		clearHelper(left);
+		throw;
+	}
+	++it;
+	root->setLeft(left);
+	if (left != NULL) left->setParent(root);
+	try {
+		root->setRight(buildBalanced(it, n - 1 - leftCount, root, rHeight));
+	} catch (...) {
+		clearHelper(root);
+		throw;
+	}
+	root->setSubtreeHeights(lHeight, rHeight);
+	SubtreeSize<NodeT::TRACKS_SIZE>::update(root);
+	height = 1 + std::max(lHeight, rHeight);
+	return root;
+}
+
+/**
+* Allocates a node and constructs its item in place from args.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+template<typename... Args>
+NodeT* BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::createNode(NodeT* parent, Args&&... args)
+{
+	NodeT* n = NodeAllocTraits::allocate(alloc_, 1);
+	try {
+		NodeAllocTraits::construct(alloc_, n, parent, std::forward<Args>(args)...);
+	} catch (...) {
+		NodeAllocTraits::deallocate(alloc_, n, 1);
+		throw;
+	}
+	if (size_ != UNKNOWN_SIZE) ++size_;
+	counter().count(&TreeStats::allocations);
+	return n;
+}
+
+/**
+* Destroys a node and hands its storage back to the allocator.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::destroyNode(NodeT* n)
+{
+	NodeAllocTraits::destroy(alloc_, n);
+	NodeAllocTraits::deallocate(alloc_, n, 1);
+	if (size_ != UNKNOWN_SIZE) --size_;
+	counter().count(&TreeStats::deallocations);
+}
+
+/**
+* Called after nodes were linked in or out wholesale.  The largest node is
+* found again, in O(height).  SizedNode trees read the new size off the
+* root; others leave it to size() to count.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::relinked()
+{
+	largest_ = getLargestNode();
+	size_ = (root_ == NULL) ? 0 : SubtreeSize<NodeT::TRACKS_SIZE>::count(root_, UNKNOWN_SIZE);
+}
+
+/**
+* Called before n is unlinked.  If n is the largest node, its in-order
+* predecessor takes over; that order does not depend on the shape of the
+* tree, so it holds however the removal relinks the nodes.  With no
+* predecessor (predecessor() then returns n) the tree is about to be
+* empty, and largest_ goes to NULL as in clear().
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::removing(NodeT* n)
+{
+	if (n != largest_) return;
+	NodeT* p = predecessor(n);
+	largest_ = (p == n) ? NULL : p;
+}
+
+/**
+* Counts the nodes of the tree at root in O(n) time and O(1) space by
+* walking it in order.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::countNodes(NodeT* root)
+{
+	std::size_t count = 0;
+	if (root == NULL) return 0;
+	NodeT* n = root;
+	while (n->getLeft() != NULL) n = n->getLeft();
+	for (; n != NULL; n = successor(n)) {
+		++count;
+	}
+	return count;
 }
 
 
@@ -698,14 +2293,13 @@ void BinarySearchTree<Key, Value>::clearHelper(Node<Key, Value>* n){
 /**
 * A helper function to find the smallest node in the tree.
 */
-template<typename Key, typename Value>
-Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+NodeT*
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::getSmallestNode() const
 {
-    // TODO / DONE?
 
 	//go left until node is leaf 
-	Node<Key, Value>* smallest = root_;
+	NodeT* smallest = root_;
 	if (root_ == NULL) return NULL;
 	while (smallest->getLeft() != NULL){
 		smallest = smallest->getLeft();
@@ -713,37 +2307,118 @@ BinarySearchTree<Key, Value>::getSmallestNode() const
 	return smallest;
 }
 
+/**
+* Returns the node with the largest key, or NULL for an empty tree.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+NodeT*
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::getLargestNode() const
+{
+	NodeT* largest = root_;
+	if (root_ == NULL) return NULL;
+	while (largest->getRight() != NULL) {
+		largest = largest->getRight();
+	}
+	return largest;
+}
+
+/**
+* getLargestNode() in O(1).  Every change keeps largest_ current: a new
+* leaf right of it takes its place (see linkLeaf()), removing it passes
+* the role to its predecessor (see removing()), rotations keep the order
+* and wholesale relinking looks it up again (see relinked()).  Nothing is
+* written here, so const callers can share the tree.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+NodeT*
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::lastNode() const
+{
+	return largest_;
+}
+
+/**
+* An iterator to n, or the end iterator for NULL, for derived trees that
+* find nodes themselves.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iteratorAt(NodeT* n) const
+{
+	return iterator(n, this);
+}
+
 /**
 * Helper function to find a node with given key, k and
 * return a pointer to it or NULL if no item with that key
-* exists
+* exists.  Only the lower bound can hold k, so the descent
+* compares with "less than" alone and equality is tested once.
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+template<typename K>
+NodeT* BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::internalFind(const K& key) const
 {
-    // TODO / DONE?
-	Node<Key, Value>* curr = root_;
-	while (curr != NULL) {
-		if (curr->getKey() == key) return curr;
-		if (key < curr->getKey()) curr = curr->getLeft();
-		else curr = curr->getRight();
-	}
+	NodeT* bound = internalLowerBound(key);
+	if (bound != NULL && !keyLess(key, bound->getKey())) return bound;
 	//didn't find 
 	return NULL;
 }
 
+/**
+* Helper function to find the first node whose key is not less than
+* key, or NULL if every key is smaller.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+template<typename K>
+NodeT* BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::internalLowerBound(const K& key) const
+{
+	NodeT* curr = root_;
+	NodeT* bound = NULL;
+	while (curr != NULL) {
+		counter().count(&TreeStats::nodesVisited);
+		if (keyLess(curr->getKey(), key)) {
+			curr = curr->getRight();
+		} else {
+			// candidate, but a smaller one may be on the left
+			bound = curr;
+			curr = curr->getLeft();
+		}
+	}
+	return bound;
+}
+
+/**
+* Helper function to find the first node whose key is greater than
+* key, or NULL if there is none.
+*/
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+template<typename K>
+NodeT* BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::internalUpperBound(const K& key) const
+{
+	NodeT* curr = root_;
+	NodeT* bound = NULL;
+	while (curr != NULL) {
+		counter().count(&TreeStats::nodesVisited);
+		if (keyLess(key, curr->getKey())) {
+			bound = curr;
+			curr = curr->getLeft();
+		} else {
+			curr = curr->getRight();
+		}
+	}
+	return bound;
+}
+
 /**
  * Return true iff the BST is balanced.
  */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+bool BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::isBalanced() const
 {
-	// TODO / DONE?
     return (isBalancedHelper(root_) != -1);
 }
 
-template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>::isBalancedHelper(Node<Key, Value>* curr) const {
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+int BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::isBalancedHelper(NodeT* curr) const {
 	//return -1 if unbalanced 
 	if (curr == NULL) return 0;
 	//post order traversal 
@@ -758,27 +2433,61 @@ int BinarySearchTree<Key, Value>::isBalancedHelper(Node<Key, Value>* curr) const
 	
 }
 
+/**
+ * Checks every structural invariant of the tree and throws
+ * std::logic_error naming the first one broken: keys in strictly
+ * increasing order, parent links that agree with child links, subtree
+ * sizes, size() and the cached largest node.  O(n) and meant for
+ * debugging; derived trees add their own invariants.  Comparisons made
+ * here are not counted in stats().
+ */
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::validate() const
+{
+    if (root_ != NULL && root_->getParent() != NULL) throw std::logic_error("validate: root has a parent");
+
+    NodeT* n = root_;
+    while (n != NULL && n->getLeft() != NULL) n = n->getLeft();
+    NodeT* prev = NULL;
+    std::size_t count = 0;
+    for (; n != NULL; prev = n, n = successor(n)) {
+        ++count;
+        if ((n->getLeft() != NULL && n->getLeft()->getParent() != n) ||
+            (n->getRight() != NULL && n->getRight()->getParent() != n)) {
+            throw std::logic_error("validate: child does not point back to its parent");
+        }
+        if (prev != NULL && !comp_(prev->getKey(), n->getKey())) {
+            throw std::logic_error("validate: keys out of order");
+        }
+        if (!SubtreeSize<NodeT::TRACKS_SIZE>::check(n)) {
+            throw std::logic_error("validate: stale subtree size");
+        }
+    }
+    if (size_ != UNKNOWN_SIZE && size_ != count) throw std::logic_error("validate: size does not match the nodes");
+    if (largest_ != prev) throw std::logic_error("validate: stale largest node");
+}
+
 
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+template<typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::nodeSwap( NodeT* n1, NodeT* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
     }
-    Node<Key, Value>* n1p = n1->getParent();
-    Node<Key, Value>* n1r = n1->getRight();
-    Node<Key, Value>* n1lt = n1->getLeft();
+    NodeT* n1p = n1->getParent();
+    NodeT* n1r = n1->getRight();
+    NodeT* n1lt = n1->getLeft();
     bool n1isLeft = false;
     if(n1p != NULL && (n1 == n1p->getLeft())) n1isLeft = true;
-    Node<Key, Value>* n2p = n2->getParent();
-    Node<Key, Value>* n2r = n2->getRight();
-    Node<Key, Value>* n2lt = n2->getLeft();
+    NodeT* n2p = n2->getParent();
+    NodeT* n2r = n2->getRight();
+    NodeT* n2lt = n2->getLeft();
     bool n2isLeft = false;
     if(n2p != NULL && (n2 == n2p->getLeft())) n2isLeft = true;
 
 
-    Node<Key, Value>* temp;
+    NodeT* temp;
     temp = n1->getParent();
     n1->setParent(n2->getParent());
     n2->setParent(temp);
@@ -842,6 +2551,8 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
         this->root_ = n1;
     }
 
+    // subtree sizes belong to the positions, not the nodes
+    SubtreeSize<NodeT::TRACKS_SIZE>::swap(n1, n2);
 }
 
 /**
@@ -0,0 +1,1160 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/**
+ * An ordered map stored as a B+ tree, with the interface of
+ * BinarySearchTree: insert, remove, find, operator[], begin/end and
+ * bidirectional iterator and const_iterator types, with their reverse
+ * iterators.  Switching a hot path from AVLTree is a change of type.
+ *
+ * Each node holds many keys in one contiguous block of about NODE_BYTES,
+ * so a lookup touches a few cache lines per level over a height of
+ * log_B(n) instead of one line per level over a height of log_2(n).
+ * Items live in the leaves, which are chained both ways for iteration;
+ * inner nodes hold only separator keys and child links.
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class BTree
+{
+public:
+    BTree();
+    explicit BTree(const Compare& comp);
+    template<typename ForwardIt>
+    BTree(ForwardIt first, ForwardIt last, const Compare& comp = Compare());
+    BTree(BTree&& other);
+    BTree& operator=(BTree&& other);
+    ~BTree();
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void insert(std::pair<Key, Value>&& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+
+protected:
+    typedef std::pair<const Key, Value> Item;
+
+    // Target bytes of keys (or items) per node
+    static const std::size_t NODE_BYTES = 512;
+    static const std::size_t LEAF_SLOTS =
+        NODE_BYTES / sizeof(Item) > 4 ? NODE_BYTES / sizeof(Item) : 4;
+    static const std::size_t INNER_SLOTS =
+        NODE_BYTES / (sizeof(Key) + sizeof(void*)) > 4 ? NODE_BYTES / (sizeof(Key) + sizeof(void*)) : 4;
+
+    struct NodeBase {
+        explicit NodeBase(bool leaf);
+        bool leaf_;
+        std::size_t count_;
+    };
+
+    // Items live in raw storage, constructed only in [0, count_).  One
+    // spare slot lets insert overfill a node before splitting it.
+    struct Leaf : NodeBase {
+        Leaf();
+        Item* items();
+        Leaf* next_;
+        Leaf* prev_;
+        typename std::aligned_storage<sizeof(Item), alignof(Item)>::type items_[LEAF_SLOTS + 1];
+    };
+
+    // keys()[i] separates children_[i], whose keys are all smaller, from
+    // children_[i + 1], whose keys are all at least as large.
+    struct Inner : NodeBase {
+        Inner();
+        Key* keys();
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type keys_[INNER_SLOTS + 1];
+        NodeBase* children_[INNER_SLOTS + 2];
+    };
+
+public:
+    class const_iterator;
+
+    /**
+    * An iterator over the items in key order, following the leaf chain.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class BTree<Key, Value, Compare>;
+        iterator(Leaf* leaf, std::size_t index, const BTree* tree);
+        Leaf* leaf_;
+        std::size_t index_;
+        // The tree, for stepping back from end()
+        const BTree* tree_;
+    };
+
+    /**
+    * An iterator that gives read-only access to the items, as returned
+    * by the lookups on a const tree.  Any iterator converts to one.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const iterator& it);
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    protected:
+        Leaf* leaf_;
+        std::size_t index_;
+        const BTree* tree_;
+    };
+
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+public:
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin();
+    reverse_iterator rend();
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator rend() const;
+    const_reverse_iterator crbegin() const;
+    const_reverse_iterator crend() const;
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key);
+    const_iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key);
+    const_iterator upper_bound(const Key& key) const;
+    Compare key_comp() const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    Leaf* findLeaf(const Key& key) const;
+    Leaf* firstLeaf() const;
+    Leaf* lastLeaf() const;
+    iterator internalFind(const Key& key) const;
+    iterator internalLowerBound(const Key& key) const;
+    iterator internalUpperBound(const Key& key) const;
+    std::size_t leafLowerBound(Leaf* leaf, const Key& key) const;
+    std::size_t leafUpperBound(Leaf* leaf, const Key& key) const;
+    std::size_t childIndex(Inner* inner, const Key& key) const;
+    iterator normalize(Leaf* leaf, std::size_t index) const;
+
+    template<typename P>
+    void insertItem(P&& keyValuePair);
+    template<typename P>
+    bool insertHelper(NodeBase* n, P&& keyValuePair, NodeBase*& split, std::optional<Key>& separator);
+    bool removeHelper(NodeBase* n, const Key& key);
+    void fixChild(Inner* parent, std::size_t c);
+    void borrowFromLeft(Inner* parent, std::size_t c);
+    void borrowFromRight(Inner* parent, std::size_t c);
+    void merge(Inner* parent, std::size_t i);
+    static std::size_t minCount(NodeBase* n);
+    static void clearHelper(NodeBase* n);
+
+    template<typename T>
+    static void shiftUp(T* a, std::size_t from, std::size_t count);
+    template<typename T>
+    static void shiftDown(T* a, std::size_t from, std::size_t count);
+    template<typename T>
+    static void relocate(T* dst, T* src, std::size_t n);
+
+    NodeBase* root_;
+    std::size_t size_;
+    Compare comp_;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the BTree node structs.
+  -----------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::NodeBase::NodeBase(bool leaf) :
+    leaf_(leaf),
+    count_(0)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::Leaf::Leaf() :
+    NodeBase(true),
+    next_(NULL),
+    prev_(NULL)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::Item* BTree<Key, Value, Compare>::Leaf::items()
+{
+    return reinterpret_cast<Item*>(items_);
+}
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::Inner::Inner() :
+    NodeBase(false)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+Key* BTree<Key, Value, Compare>::Inner::keys()
+{
+    return reinterpret_cast<Key*>(keys_);
+}
+
+/*
+  ---------------------------------------
+  End implementations for the BTree node structs.
+  ---------------------------------------
+*/
+
+/*
+  -----------------------------------------
+  Begin implementations for the BTree::iterator class.
+  -----------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::iterator::iterator() :
+    leaf_(NULL),
+    index_(0),
+    tree_(NULL)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::iterator::iterator(Leaf* leaf, std::size_t index, const BTree* tree) :
+    leaf_(leaf),
+    index_(index),
+    tree_(tree)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+std::pair<const Key,Value>& BTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return leaf_->items()[index_];
+}
+
+template<typename Key, typename Value, typename Compare>
+std::pair<const Key,Value>* BTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(leaf_->items()[index_]);
+}
+
+template<typename Key, typename Value, typename Compare>
+bool BTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool BTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename Key, typename Value, typename Compare>
+bool BTree<Key, Value, Compare>::iterator::operator==(const const_iterator& rhs) const
+{
+    return rhs == *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool BTree<Key, Value, Compare>::iterator::operator!=(const const_iterator& rhs) const
+{
+    return rhs != *this;
+}
+
+/**
+* Steps within the leaf, then on to the next one.  Leaves are never
+* empty, so the first item of the next leaf is always there.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator& BTree<Key, Value, Compare>::iterator::operator++()
+{
+    if (++index_ == leaf_->count_) {
+        leaf_ = leaf_->next_;
+        index_ = 0;
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old = *this;
+    ++(*this);
+    return old;
+}
+
+/**
+* Steps back within the leaf, or to the last item of the previous one.
+* Stepping back from end() lands on the last item of the last leaf.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator& BTree<Key, Value, Compare>::iterator::operator--()
+{
+    if (index_ == 0) {
+        leaf_ = (leaf_ == NULL) ? tree_->lastLeaf() : leaf_->prev_;
+        index_ = leaf_->count_;
+    }
+    --index_;
+    return *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old = *this;
+    --(*this);
+    return old;
+}
+
+/*
+  ---------------------------------------
+  End implementations for the BTree::iterator class.
+  ---------------------------------------
+*/
+
+/*
+  -----------------------------------------
+  Begin implementations for the BTree::const_iterator class.
+  -----------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::const_iterator::const_iterator() :
+    leaf_(NULL),
+    index_(0),
+    tree_(NULL)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::const_iterator::const_iterator(const iterator& it) :
+    leaf_(it.leaf_),
+    index_(it.index_),
+    tree_(it.tree_)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+const std::pair<const Key,Value>& BTree<Key, Value, Compare>::const_iterator::operator*() const
+{
+    return leaf_->items()[index_];
+}
+
+template<typename Key, typename Value, typename Compare>
+const std::pair<const Key,Value>* BTree<Key, Value, Compare>::const_iterator::operator->() const
+{
+    return &(leaf_->items()[index_]);
+}
+
+template<typename Key, typename Value, typename Compare>
+bool BTree<Key, Value, Compare>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool BTree<Key, Value, Compare>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* See iterator::operator++().
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator& BTree<Key, Value, Compare>::const_iterator::operator++()
+{
+    if (++index_ == leaf_->count_) {
+        leaf_ = leaf_->next_;
+        index_ = 0;
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator BTree<Key, Value, Compare>::const_iterator::operator++(int)
+{
+    const_iterator old = *this;
+    ++(*this);
+    return old;
+}
+
+/**
+* See iterator::operator--().
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator& BTree<Key, Value, Compare>::const_iterator::operator--()
+{
+    if (index_ == 0) {
+        leaf_ = (leaf_ == NULL) ? tree_->lastLeaf() : leaf_->prev_;
+        index_ = leaf_->count_;
+    }
+    --index_;
+    return *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator BTree<Key, Value, Compare>::const_iterator::operator--(int)
+{
+    const_iterator old = *this;
+    --(*this);
+    return old;
+}
+
+/*
+  ---------------------------------------
+  End implementations for the BTree::const_iterator class.
+  ---------------------------------------
+*/
+
+/*
+  -----------------------------------------
+  Begin implementations for the BTree class.
+  -----------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::BTree() :
+    root_(NULL),
+    size_(0)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::BTree(const Compare& comp) :
+    root_(NULL),
+    size_(0),
+    comp_(comp)
+{
+
+}
+
+/**
+* Inserts the items of [first, last); later duplicates replace earlier ones.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename ForwardIt>
+BTree<Key, Value, Compare>::BTree(ForwardIt first, ForwardIt last, const Compare& comp) :
+    root_(NULL),
+    size_(0),
+    comp_(comp)
+{
+    for (; first != last; ++first) {
+        insertItem(*first);
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::BTree(BTree&& other) :
+    root_(other.root_),
+    size_(other.size_),
+    comp_(other.comp_)
+{
+    other.root_ = NULL;
+    other.size_ = 0;
+}
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>& BTree<Key, Value, Compare>::operator=(BTree&& other)
+{
+    if (this != &other) {
+        clear();
+        root_ = other.root_;
+        size_ = other.size_;
+        comp_ = other.comp_;
+        other.root_ = NULL;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+BTree<Key, Value, Compare>::~BTree()
+{
+    clear();
+}
+
+/**
+* Inserts an item, replacing the value if the key is already present.
+*/
+template<typename Key, typename Value, typename Compare>
+void BTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    insertItem(keyValuePair);
+}
+
+template<typename Key, typename Value, typename Compare>
+void BTree<Key, Value, Compare>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+    insertItem(std::move(keyValuePair));
+}
+
+/**
+* Inserts through the tree; when the root splits, a new root is placed
+* above the two halves and the tree grows by one level.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename P>
+void BTree<Key, Value, Compare>::insertItem(P&& keyValuePair)
+{
+    if (root_ == NULL) root_ = new Leaf();
+    NodeBase* split = NULL;
+    std::optional<Key> separator;
+    if (insertHelper(root_, std::forward<P>(keyValuePair), split, separator)) ++size_;
+    if (split != NULL) {
+        Inner* root = new Inner();
+        new (root->keys()) Key(std::move(*separator));
+        root->children_[0] = root_;
+        root->children_[1] = split;
+        root->count_ = 1;
+        root_ = root;
+    }
+}
+
+/**
+* Inserts into the subtree at n and returns true if the key was new.
+* A node left holding one item or key too many is split in half: the
+* upper half moves to a new node returned in split, and the first key
+* at or above it in separator.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename P>
+bool BTree<Key, Value, Compare>::insertHelper(NodeBase* n, P&& keyValuePair, NodeBase*& split, std::optional<Key>& separator)
+{
+    if (n->leaf_) {
+        Leaf* leaf = static_cast<Leaf*>(n);
+        Item* items = leaf->items();
+        std::size_t i = leafLowerBound(leaf, keyValuePair.first);
+        if (i < leaf->count_ && !comp_(keyValuePair.first, items[i].first)) {
+            items[i].second = std::forward<P>(keyValuePair).second;
+            return false;
+        }
+        shiftUp(items, i, leaf->count_);
+        new (items + i) Item(std::forward<P>(keyValuePair));
+        if (++leaf->count_ > LEAF_SLOTS) {
+            Leaf* right = new Leaf();
+            std::size_t mid = leaf->count_ / 2;
+            relocate(right->items(), items + mid, leaf->count_ - mid);
+            right->count_ = leaf->count_ - mid;
+            leaf->count_ = mid;
+            right->next_ = leaf->next_;
+            right->prev_ = leaf;
+            if (right->next_ != NULL) right->next_->prev_ = right;
+            leaf->next_ = right;
+            split = right;
+            separator.emplace(right->items()[0].first);
+        }
+        return true;
+    }
+
+    Inner* inner = static_cast<Inner*>(n);
+    std::size_t c = childIndex(inner, keyValuePair.first);
+    NodeBase* childSplit = NULL;
+    std::optional<Key> childSeparator;
+    bool added = insertHelper(inner->children_[c], std::forward<P>(keyValuePair), childSplit, childSeparator);
+    if (childSplit == NULL) return added;
+
+    Key* keys = inner->keys();
+    shiftUp(keys, c, inner->count_);
+    new (keys + c) Key(std::move(*childSeparator));
+    std::copy_backward(inner->children_ + c + 1, inner->children_ + inner->count_ + 1,
+                       inner->children_ + inner->count_ + 2);
+    inner->children_[c + 1] = childSplit;
+    if (++inner->count_ > INNER_SLOTS) {
+        // the middle key moves up; the keys on either side stay below it
+        Inner* right = new Inner();
+        std::size_t mid = inner->count_ / 2;
+        separator.emplace(std::move(keys[mid]));
+        keys[mid].~Key();
+        relocate(right->keys(), keys + mid + 1, inner->count_ - mid - 1);
+        std::copy(inner->children_ + mid + 1, inner->children_ + inner->count_ + 1, right->children_);
+        right->count_ = inner->count_ - mid - 1;
+        inner->count_ = mid;
+        split = right;
+    }
+    return added;
+}
+
+/**
+* Removes key, if present.  When the root runs out of keys the tree
+* loses a level.
+*/
+template<typename Key, typename Value, typename Compare>
+void BTree<Key, Value, Compare>::remove(const Key& key)
+{
+    if (root_ == NULL || !removeHelper(root_, key)) return;
+    --size_;
+    if (root_->count_ == 0) {
+        NodeBase* old = root_;
+        root_ = old->leaf_ ? NULL : static_cast<Inner*>(old)->children_[0];
+        if (old->leaf_) delete static_cast<Leaf*>(old);
+        else delete static_cast<Inner*>(old);
+    }
+}
+
+/**
+* Removes key from the subtree at n and returns true if it was there.
+* A child left below minCount() is refilled by fixChild().
+*/
+template<typename Key, typename Value, typename Compare>
+bool BTree<Key, Value, Compare>::removeHelper(NodeBase* n, const Key& key)
+{
+    if (n->leaf_) {
+        Leaf* leaf = static_cast<Leaf*>(n);
+        Item* items = leaf->items();
+        std::size_t i = leafLowerBound(leaf, key);
+        if (i == leaf->count_ || comp_(key, items[i].first)) return false;
+        items[i].~Item();
+        shiftDown(items, i, leaf->count_);
+        --leaf->count_;
+        return true;
+    }
+    Inner* inner = static_cast<Inner*>(n);
+    std::size_t c = childIndex(inner, key);
+    if (!removeHelper(inner->children_[c], key)) return false;
+    if (inner->children_[c]->count_ < minCount(inner->children_[c])) fixChild(inner, c);
+    return true;
+}
+
+/**
+* Fewest items (leaf) or keys (inner node) a node other than the root
+* may hold.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t BTree<Key, Value, Compare>::minCount(NodeBase* n)
+{
+    return (n->leaf_ ? LEAF_SLOTS : INNER_SLOTS) / 2;
+}
+
+/**
+* Refills child c of parent, which is one short: it borrows from a
+* sibling with some to spare, or else merges with one.
+*/
+template<typename Key, typename Value, typename Compare>
+void BTree<Key, Value, Compare>::fixChild(Inner* parent, std::size_t c)
+{
+    NodeBase** children = parent->children_;
+    if (c > 0 && children[c - 1]->count_ > minCount(children[c - 1])) {
+        borrowFromLeft(parent, c);
+    } else if (c < parent->count_ && children[c + 1]->count_ > minCount(children[c + 1])) {
+        borrowFromRight(parent, c);
+    } else if (c > 0) {
+        merge(parent, c - 1);
+    } else {
+        merge(parent, c);
+    }
+}
+
+/**
+* Moves the last item (or link) of child c - 1 to the front of child c.
+* Inner nodes rotate the key through the parent.
+*/
+template<typename Key, typename Value, typename Compare>
+void BTree<Key, Value, Compare>::borrowFromLeft(Inner* parent, std::size_t c)
+{
+    Key* sep = parent->keys() + c - 1;
+    if (parent->children_[c]->leaf_) {
+        Leaf* left = static_cast<Leaf*>(parent->children_[c - 1]);
+        Leaf* child = static_cast<Leaf*>(parent->children_[c]);
+        shiftUp(child->items(), 0, child->count_);
+        relocate(child->items(), left->items() + left->count_ - 1, 1);
+        --left->count_;
+        ++child->count_;
+        *sep = child->items()[0].first;
+    } else {
+        Inner* left = static_cast<Inner*>(parent->children_[c - 1]);
+        Inner* child = static_cast<Inner*>(parent->children_[c]);
+        shiftUp(child->keys(), 0, child->count_);
+        new (child->keys()) Key(std::move(*sep));
+        std::copy_backward(child->children_, child->children_ + child->count_ + 1,
+                           child->children_ + child->count_ + 2);
+        child->children_[0] = left->children_[left->count_];
+        *sep = std::move(left->keys()[left->count_ - 1]);
+        left->keys()[left->count_ - 1].~Key();
+        --left->count_;
+        ++child->count_;
+    }
+}
+
+/**
+* Moves the first item (or link) of child c + 1 to the end of child c.
+*/
+template<typename Key, typename Value, typename Compare>
+void BTree<Key, Value, Compare>::borrowFromRight(Inner* parent, std::size_t c)
+{
+    Key* sep = parent->keys() + c;
+    if (parent->children_[c]->leaf_) {
+        Leaf* child = static_cast<Leaf*>(parent->children_[c]);
+        Leaf* right = static_cast<Leaf*>(parent->children_[c + 1]);
+        relocate(child->items() + child->count_, right->items(), 1);
+        shiftDown(right->items(), 0, right->count_);
+        --right->count_;
+        ++child->count_;
+        *sep = right->items()[0].first;
+    } else {
+        Inner* child = static_cast<Inner*>(parent->children_[c]);
+        Inner* right = static_cast<Inner*>(parent->children_[c + 1]);
+        new (child->keys() + child->count_) Key(std::move(*sep));
+        child->children_[child->count_ + 1] = right->children_[0];
+        *sep = std::move(right->keys()[0]);
+        right->keys()[0].~Key();
+        shiftDown(right->keys(), 0, right->count_);
+        std::copy(right->children_ + 1, right->children_ + right->count_ + 1, right->children_);
+        --right->count_;
+        ++child->count_;
+    }
+}
+
+/**
+* Folds child i + 1 of parent into child i and drops the separator
+* between them.  Inner nodes pull the separator down between the halves.
+*/
+template<typename Key, typename Value, typename Compare>
+void BTree<Key, Value, Compare>::merge(Inner* parent, std::size_t i)
+{
+    Key* keys = parent->keys();
+    if (parent->children_[i]->leaf_) {
+        Leaf* left = static_cast<Leaf*>(parent->children_[i]);
+        Leaf* right = static_cast<Leaf*>(parent->children_[i + 1]);
+        relocate(left->items() + left->count_, right->items(), right->count_);
+        left->count_ += right->count_;
+        left->next_ = right->next_;
+        if (left->next_ != NULL) left->next_->prev_ = left;
+        delete right;
+    } else {
+        Inner* left = static_cast<Inner*>(parent->children_[i]);
+        Inner* right = static_cast<Inner*>(parent->children_[i + 1]);
+        new (left->keys() + left->count_) Key(std::move(keys[i]));
+        relocate(left->keys() + left->count_ + 1, right->keys(), right->count_);
+        std::copy(right->children_, right->children_ + right->count_ + 1,
+                  left->children_ + left->count_ + 1);
+        left->count_ += right->count_ + 1;
+        delete right;
+    }
+    keys[i].~Key();
+    shiftDown(keys, i, parent->count_);
+    std::copy(parent->children_ + i + 2, parent->children_ + parent->count_ + 1,
+              parent->children_ + i + 1);
+    --parent->count_;
+}
+
+/**
+* Deletes every node.
+*/
+template<typename Key, typename Value, typename Compare>
+void BTree<Key, Value, Compare>::clear()
+{
+    clearHelper(root_);
+    root_ = NULL;
+    size_ = 0;
+}
+
+template<typename Key, typename Value, typename Compare>
+void BTree<Key, Value, Compare>::clearHelper(NodeBase* n)
+{
+    if (n == NULL) return;
+    if (n->leaf_) {
+        Leaf* leaf = static_cast<Leaf*>(n);
+        for (std::size_t i = 0; i < leaf->count_; ++i) {
+            leaf->items()[i].~Item();
+        }
+        delete leaf;
+        return;
+    }
+    Inner* inner = static_cast<Inner*>(n);
+    for (std::size_t i = 0; i <= inner->count_; ++i) {
+        clearHelper(inner->children_[i]);
+    }
+    for (std::size_t i = 0; i < inner->count_; ++i) {
+        inner->keys()[i].~Key();
+    }
+    delete inner;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool BTree<Key, Value, Compare>::empty() const
+{
+    return root_ == NULL;
+}
+
+template<typename Key, typename Value, typename Compare>
+std::size_t BTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::begin()
+{
+    return iterator(firstLeaf(), 0, this);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::end()
+{
+    return iterator(NULL, 0, this);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator BTree<Key, Value, Compare>::begin() const
+{
+    return iterator(firstLeaf(), 0, this);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator BTree<Key, Value, Compare>::end() const
+{
+    return iterator(NULL, 0, this);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator BTree<Key, Value, Compare>::cbegin() const
+{
+    return begin();
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator BTree<Key, Value, Compare>::cend() const
+{
+    return end();
+}
+
+/**
+* Returns a reverse iterator to the largest item.  Finding the last leaf
+* takes one descent of log_B(n) levels.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::reverse_iterator BTree<Key, Value, Compare>::rbegin()
+{
+    return reverse_iterator(end());
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::reverse_iterator BTree<Key, Value, Compare>::rend()
+{
+    return reverse_iterator(begin());
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_reverse_iterator BTree<Key, Value, Compare>::rbegin() const
+{
+    return const_reverse_iterator(end());
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_reverse_iterator BTree<Key, Value, Compare>::rend() const
+{
+    return const_reverse_iterator(begin());
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_reverse_iterator BTree<Key, Value, Compare>::crbegin() const
+{
+    return rbegin();
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_reverse_iterator BTree<Key, Value, Compare>::crend() const
+{
+    return rend();
+}
+
+/**
+* Returns an iterator to the item with key, or end() if there is none.
+* On a const tree this and the bounds below return a const_iterator.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::find(const Key& key)
+{
+    return internalFind(key);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator BTree<Key, Value, Compare>::find(const Key& key) const
+{
+    return internalFind(key);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::lower_bound(const Key& key)
+{
+    return internalLowerBound(key);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator BTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return internalLowerBound(key);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::upper_bound(const Key& key)
+{
+    return internalUpperBound(key);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::const_iterator BTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return internalUpperBound(key);
+}
+
+template<typename Key, typename Value, typename Compare>
+Compare BTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+template<typename Key, typename Value, typename Compare>
+Value& BTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<typename Key, typename Value, typename Compare>
+Value const & BTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    const_iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* An index one past a leaf's last item means the first item of the next
+* leaf, which is larger than everything the search passed over.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::normalize(Leaf* leaf, std::size_t index) const
+{
+    if (index == leaf->count_) return iterator(leaf->next_, 0, this);
+    return iterator(leaf, index, this);
+}
+
+/**
+* The iterator for find(), for both constnesses; the const overloads
+* hand it out as a const_iterator.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::internalFind(const Key& key) const
+{
+    Leaf* leaf = findLeaf(key);
+    if (leaf == NULL) return iterator(NULL, 0, this);
+    std::size_t i = leafLowerBound(leaf, key);
+    if (i == leaf->count_ || comp_(key, leaf->items()[i].first)) return iterator(NULL, 0, this);
+    return iterator(leaf, i, this);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::internalLowerBound(const Key& key) const
+{
+    Leaf* leaf = findLeaf(key);
+    if (leaf == NULL) return iterator(NULL, 0, this);
+    return normalize(leaf, leafLowerBound(leaf, key));
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::iterator BTree<Key, Value, Compare>::internalUpperBound(const Key& key) const
+{
+    Leaf* leaf = findLeaf(key);
+    if (leaf == NULL) return iterator(NULL, 0, this);
+    return normalize(leaf, leafUpperBound(leaf, key));
+}
+
+/**
+* Returns the leaf whose range holds key, or NULL for an empty tree.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::Leaf* BTree<Key, Value, Compare>::findLeaf(const Key& key) const
+{
+    NodeBase* n = root_;
+    if (n == NULL) return NULL;
+    while (!n->leaf_) {
+        Inner* inner = static_cast<Inner*>(n);
+        n = inner->children_[childIndex(inner, key)];
+    }
+    return static_cast<Leaf*>(n);
+}
+
+/**
+* The leftmost and rightmost leaves, or NULL for an empty tree.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::Leaf* BTree<Key, Value, Compare>::firstLeaf() const
+{
+    NodeBase* n = root_;
+    if (n == NULL) return NULL;
+    while (!n->leaf_) {
+        n = static_cast<Inner*>(n)->children_[0];
+    }
+    return static_cast<Leaf*>(n);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BTree<Key, Value, Compare>::Leaf* BTree<Key, Value, Compare>::lastLeaf() const
+{
+    NodeBase* n = root_;
+    if (n == NULL) return NULL;
+    while (!n->leaf_) {
+        n = static_cast<Inner*>(n)->children_[n->count_];
+    }
+    return static_cast<Leaf*>(n);
+}
+
+/**
+* Index of the first item in leaf not less than key.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t BTree<Key, Value, Compare>::leafLowerBound(Leaf* leaf, const Key& key) const
+{
+    Item* items = leaf->items();
+    std::size_t lo = 0, hi = leaf->count_;
+    while (lo < hi) {
+        std::size_t mid = (lo + hi) / 2;
+        if (comp_(items[mid].first, key)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/**
+* Index of the first item in leaf greater than key.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t BTree<Key, Value, Compare>::leafUpperBound(Leaf* leaf, const Key& key) const
+{
+    Item* items = leaf->items();
+    std::size_t lo = 0, hi = leaf->count_;
+    while (lo < hi) {
+        std::size_t mid = (lo + hi) / 2;
+        if (comp_(key, items[mid].first)) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+/**
+* Index of the child of inner whose range holds key: the number of
+* separators not greater than key.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t BTree<Key, Value, Compare>::childIndex(Inner* inner, const Key& key) const
+{
+    Key* keys = inner->keys();
+    return std::upper_bound(keys, keys + inner->count_, key, comp_) - keys;
+}
+
+/**
+* Moves a[from, count) up one slot, leaving a[from] unconstructed.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename T>
+void BTree<Key, Value, Compare>::shiftUp(T* a, std::size_t from, std::size_t count)
+{
+    for (std::size_t j = count; j > from; --j) {
+        new (a + j) T(std::move(a[j - 1]));
+        a[j - 1].~T();
+    }
+}
+
+/**
+* Moves a[from + 1, count) down one slot into the unconstructed a[from],
+* leaving a[count - 1] unconstructed.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename T>
+void BTree<Key, Value, Compare>::shiftDown(T* a, std::size_t from, std::size_t count)
+{
+    for (std::size_t j = from; j + 1 < count; ++j) {
+        new (a + j) T(std::move(a[j + 1]));
+        a[j + 1].~T();
+    }
+}
+
+/**
+* Moves n objects from src into the unconstructed dst.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename T>
+void BTree<Key, Value, Compare>::relocate(T* dst, T* src, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        new (dst + i) T(std::move(src[i]));
+        src[i].~T();
+    }
+}
+
+/*
+  ---------------------------------------
+  End implementations for the BTree class.
+  ---------------------------------------
+*/
+
+#endif
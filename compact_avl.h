@@ -0,0 +1,442 @@
+#ifndef COMPACT_AVL_H
+#define COMPACT_AVL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "avlbst.h"
+
+/**
+ * An allocator that keeps every node of type T in one contiguous array,
+ * so that nodes can link to each other by 32-bit index instead of by
+ * pointer.  Index 0 is never handed out and stands for NULL.
+ *
+ * A node finds its neighbours from the index alone, so there can be only
+ * one array per node type: it is shared by every tree using T, and all
+ * CompactPools of a type compare equal.  Unlike NodePool, whose slabs
+ * belong to one tree, the array is therefore guarded by a mutex, so
+ * trees on different threads may allocate and free at the same time
+ * (one tree is still not safe to change from two threads).
+ *
+ * The array is a single reservation of MAX_CELLS * sizeof(T) bytes of
+ * address space (16 GiB for a 16 byte node), made on first use and
+ * committed a few pages at a time as it fills, so it never moves and a
+ * node's address stays valid.  Freed cells are recycled but stay
+ * committed until release() finds no node of the type left, which hands
+ * the pages back to the OS; the reservation itself is kept for the life
+ * of the program.
+ */
+template <typename T>
+class CompactPool
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef std::size_t size_type;
+
+    // Cells addressable with the 30 index bits CompactAVLNode keeps
+    static const uint32_t MAX_CELLS = 1u << 30;
+
+    CompactPool();
+
+    T* allocate(std::size_t n);
+    void deallocate(T* p, std::size_t n);
+    void release();
+
+    static T* at(uint32_t index);
+    static uint32_t indexOf(const T* p);
+    static std::size_t bytesInUse();
+
+    bool operator==(const CompactPool<T>& rhs) const;
+    bool operator!=(const CompactPool<T>& rhs) const;
+
+private:
+    struct Arena {
+        Arena();
+        void grow();
+
+        std::size_t committed_;   // cells backed by memory
+        std::size_t next_;        // first never used cell
+        uint32_t free_;           // head of the free cell list
+        std::size_t live_;
+        std::mutex lock_;         // guards all of the above
+    };
+
+    static Arena& arena();
+
+    // Start of the array, set up by the first allocation
+    static inline char* base_ = NULL;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the CompactPool class.
+  -----------------------------------------
+*/
+
+/**
+* Reserves the address range without committing memory to it.
+*/
+template <typename T>
+CompactPool<T>::Arena::Arena() :
+    committed_(0),
+    next_(1),
+    free_(0),
+    live_(0)
+{
+    void* p = mmap(NULL, static_cast<std::size_t>(MAX_CELLS) * sizeof(T), PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+    base_ = static_cast<char*>(p);
+}
+
+/**
+* Commits the next stretch of the reservation, doubling what is
+* committed so far.
+*/
+template <typename T>
+void CompactPool<T>::Arena::grow()
+{
+    std::size_t page = sysconf(_SC_PAGESIZE);
+    std::size_t done = (committed_ * sizeof(T) + page - 1) / page * page;
+    std::size_t bytes = done < 16 * page ? 16 * page : done;
+    std::size_t limit = static_cast<std::size_t>(MAX_CELLS) * sizeof(T);
+    if (done + bytes > limit) bytes = limit - done;
+    if (bytes == 0 || mprotect(base_ + done, bytes, PROT_READ | PROT_WRITE) != 0) {
+        throw std::bad_alloc();
+    }
+    committed_ = (done + bytes) / sizeof(T);
+}
+
+/**
+* The array of node type T.  It is never destroyed, so trees with static
+* storage duration can still free their nodes during exit.
+*/
+template <typename T>
+typename CompactPool<T>::Arena& CompactPool<T>::arena()
+{
+    static Arena* arena = new Arena();
+    return *arena;
+}
+
+template <typename T>
+CompactPool<T>::CompactPool()
+{
+
+}
+
+/**
+* Returns a recycled cell, or else the next unused one.  Array requests
+* bypass the pool.
+*/
+template <typename T>
+T* CompactPool<T>::allocate(std::size_t n)
+{
+    if (n != 1) {
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    Arena& a = arena();
+    std::lock_guard<std::mutex> guard(a.lock_);
+    uint32_t index = a.free_;
+    if (index != 0) {
+        a.free_ = *reinterpret_cast<uint32_t*>(base_ + index * sizeof(T));
+    } else {
+        if (a.next_ >= a.committed_) a.grow();
+        index = static_cast<uint32_t>(a.next_++);
+    }
+    ++a.live_;
+    return reinterpret_cast<T*>(base_ + index * sizeof(T));
+}
+
+/**
+* Puts a cell on the free list, linked through its first bytes.
+*/
+template <typename T>
+void CompactPool<T>::deallocate(T* p, std::size_t n)
+{
+    if (n != 1) {
+        ::operator delete(p);
+        return;
+    }
+    Arena& a = arena();
+    std::lock_guard<std::mutex> guard(a.lock_);
+    *reinterpret_cast<uint32_t*>(p) = a.free_;
+    a.free_ = indexOf(p);
+    --a.live_;
+}
+
+/**
+* Hands the committed pages back to the OS and starts the array over,
+* if no tree holds a node of this type; otherwise does nothing.  The
+* pages stay mapped and read back as zeros until they are used again.
+*/
+template <typename T>
+void CompactPool<T>::release()
+{
+    Arena& a = arena();
+    std::lock_guard<std::mutex> guard(a.lock_);
+    if (a.live_ != 0 || a.next_ == 1) return;
+    std::size_t page = sysconf(_SC_PAGESIZE);
+    std::size_t bytes = (a.committed_ * sizeof(T) + page - 1) / page * page;
+    madvise(base_, bytes, MADV_DONTNEED);
+    a.next_ = 1;
+    a.free_ = 0;
+}
+
+/**
+* The node at index, or NULL for index 0.
+*/
+template <typename T>
+T* CompactPool<T>::at(uint32_t index)
+{
+    return index == 0 ? NULL : reinterpret_cast<T*>(base_ + index * sizeof(T));
+}
+
+/**
+* The index of p, or 0 for NULL.
+*/
+template <typename T>
+uint32_t CompactPool<T>::indexOf(const T* p)
+{
+    return p == NULL ? 0 : static_cast<uint32_t>((reinterpret_cast<const char*>(p) - base_) / sizeof(T));
+}
+
+/**
+* Bytes of node storage in use by every tree of this node type.
+*/
+template <typename T>
+std::size_t CompactPool<T>::bytesInUse()
+{
+    Arena& a = arena();
+    std::lock_guard<std::mutex> guard(a.lock_);
+    return a.live_ * sizeof(T);
+}
+
+template <typename T>
+bool CompactPool<T>::operator==(const CompactPool<T>&) const
+{
+    return true;
+}
+
+template <typename T>
+bool CompactPool<T>::operator!=(const CompactPool<T>&) const
+{
+    return false;
+}
+
+/*
+  ---------------------------------------
+  End implementations for the CompactPool class.
+  ---------------------------------------
+*/
+
+/**
+* Lets a tree's clear() hand the array's pages back once it was the last
+* tree of its node type; see CompactPool::release().
+*/
+template <typename T>
+void releaseSlabs(CompactPool<T>& pool)
+{
+    pool.release();
+}
+
+/**
+ * An AVL node that links by 32-bit index into its CompactPool and keeps
+ * its balance, which is always -1, 0 or 1 once stored, in the top two
+ * bits of the parent index.  It has AVLNode's interface, so AVLTree runs
+ * on it unchanged; for AVLTree<uint16_t, uint16_t> a node takes 16 bytes
+ * rather than AVLNode's 40.
+ */
+template <typename Key, typename Value>
+class CompactAVLNode
+{
+public:
+    typedef CompactPool<CompactAVLNode<Key, Value> > Pool;
+
+    CompactAVLNode(const Key& key, const Value& value, CompactAVLNode<Key, Value>* parent);
+    template<typename... Args>
+    CompactAVLNode(CompactAVLNode<Key, Value>* parent, Args&&... args);
+
+    const std::pair<const Key, Value>& getItem() const;
+    std::pair<const Key, Value>& getItem();
+    const Key& getKey() const;
+    const Value& getValue() const;
+    Value& getValue();
+
+    CompactAVLNode<Key, Value>* getParent() const;
+    CompactAVLNode<Key, Value>* getLeft() const;
+    CompactAVLNode<Key, Value>* getRight() const;
+
+    void setParent(CompactAVLNode<Key, Value>* parent);
+    void setLeft(CompactAVLNode<Key, Value>* left);
+    void setRight(CompactAVLNode<Key, Value>* right);
+    void setValue(const Value &value);
+    void setValue(Value&& value);
+
+    int8_t getBalance () const;
+    void setBalance (int8_t balance);
+    void updateBalance(int8_t diff);
+    void setSubtreeHeights(int leftHeight, int rightHeight);
+
+    static const bool TRACKS_SIZE = false;
+
+protected:
+    static const uint32_t INDEX_MASK = CompactPool<CompactAVLNode<Key, Value> >::MAX_CELLS - 1;
+    static const int BALANCE_SHIFT = 30;
+
+    std::pair<const Key, Value> item_;
+    uint32_t parent_;   // balance + 1 above the parent's index
+    uint32_t left_;
+    uint32_t right_;
+};
+
+/**
+* An AVLTree whose nodes are CompactAVLNodes.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+using CompactAVLTree = AVLTree<Key, Value, Compare, CompactAVLNode<Key, Value>,
+                               CompactPool<CompactAVLNode<Key, Value> > >;
+
+/*
+  -----------------------------------------
+  Begin implementations for the CompactAVLNode class.
+  -----------------------------------------
+*/
+
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(const Key& key, const Value& value, CompactAVLNode<Key, Value>* parent) :
+    item_(key, value),
+    parent_((1u << BALANCE_SHIFT) | Pool::indexOf(parent)),
+    left_(0),
+    right_(0)
+{
+
+}
+
+/**
+* Constructs the item in place from args; see Node.
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+CompactAVLNode<Key, Value>::CompactAVLNode(CompactAVLNode<Key, Value>* parent, Args&&... args) :
+    item_(std::forward<Args>(args)...),
+    parent_((1u << BALANCE_SHIFT) | Pool::indexOf(parent)),
+    left_(0),
+    right_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+const std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<typename Key, typename Value>
+std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem()
+{
+    return item_;
+}
+
+template<typename Key, typename Value>
+const Key& CompactAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<typename Key, typename Value>
+const Value& CompactAVLNode<Key, Value>::getValue() const
+{
+    return item_.second;
+}
+
+template<typename Key, typename Value>
+Value& CompactAVLNode<Key, Value>::getValue()
+{
+    return item_.second;
+}
+
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>* CompactAVLNode<Key, Value>::getParent() const
+{
+    return Pool::at(parent_ & INDEX_MASK);
+}
+
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>* CompactAVLNode<Key, Value>::getLeft() const
+{
+    return Pool::at(left_);
+}
+
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>* CompactAVLNode<Key, Value>::getRight() const
+{
+    return Pool::at(right_);
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setParent(CompactAVLNode<Key, Value>* parent)
+{
+    parent_ = (parent_ & ~INDEX_MASK) | Pool::indexOf(parent);
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setLeft(CompactAVLNode<Key, Value>* left)
+{
+    left_ = Pool::indexOf(left);
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setRight(CompactAVLNode<Key, Value>* right)
+{
+    right_ = Pool::indexOf(right);
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setValue(const Value& value)
+{
+    item_.second = value;
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setValue(Value&& value)
+{
+    item_.second = std::move(value);
+}
+
+template<typename Key, typename Value>
+int8_t CompactAVLNode<Key, Value>::getBalance() const
+{
+    return static_cast<int8_t>(parent_ >> BALANCE_SHIFT) - 1;
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setBalance(int8_t balance)
+{
+    parent_ = (parent_ & INDEX_MASK) | (static_cast<uint32_t>(balance + 1) << BALANCE_SHIFT);
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::updateBalance(int8_t diff)
+{
+    setBalance(getBalance() + diff);
+}
+
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setSubtreeHeights(int leftHeight, int rightHeight)
+{
+    setBalance(rightHeight - leftHeight);
+}
+
+/*
+  ---------------------------------------
+  End implementations for the CompactAVLNode class.
+  ---------------------------------------
+*/
+
+#endif
@@ -0,0 +1,400 @@
+#ifndef CONCURRENT_AVL_H
+#define CONCURRENT_AVL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+ * A thread-safe map built on AVLTree, with its lock striped: the keys
+ * are spread by hash over SHARDS AVLTrees, each with its own
+ * reader-writer lock and version on its own cache line.  An insert or
+ * remove takes one shard's lock exclusively and keeps the shard's
+ * version odd while it changes the tree, so writers on different shards
+ * never wait for each other.
+ *
+ * find() and contains() validate optimistically, as a seqlock does: they
+ * read an even version, descend without locking anything, and keep the
+ * answer only if the version is still the same afterwards.  A reader
+ * thus writes no shared memory at all, and is not held up by a writer
+ * unless that writer is on its shard at the time.  After OPTIMISTIC_TRIES
+ * changes get in the way, or always when Key or Value is not trivially
+ * copyable, the lookup takes the shard's lock shared instead.
+ *
+ * The optimistic descent may read nodes while a writer relinks them, so
+ * it is cut off after MAX_DEPTH levels and copies bytes rather than
+ * calling Value's copy, and node memory is never handed back while the
+ * map lives: removed nodes return to the shard's pool, and clear() keeps
+ * the pool's slabs.  Compare may still be called on a torn key, which
+ * the built-in comparisons of trivially copyable keys shrug off.
+ * (Strictly, those overlapping plain reads are a data race in the C++
+ * memory model, as in any seqlock over non-atomic data.)
+ *
+ * Hash must give equal hashes to keys that Compare finds equivalent,
+ * as std::hash does for std::less.  Iterators would be left dangling
+ * by a concurrent remove, so results come back by value and whole-map
+ * walks go through forEach(), which merges the shards back into key
+ * order.  size(), empty() and forEach() lock every shard, in order, so
+ * they see one consistent state but hold off all writers meanwhile.
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename Hash = std::hash<Key> >
+class ConcurrentAVLTree
+{
+public:
+    ConcurrentAVLTree();
+    explicit ConcurrentAVLTree(const Compare& comp, const Hash& hash = Hash());
+    ConcurrentAVLTree(const ConcurrentAVLTree&) = delete;
+    ConcurrentAVLTree& operator=(const ConcurrentAVLTree&) = delete;
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void insert(std::pair<Key, Value>&& keyValuePair);
+    bool remove(const Key& key);
+    void clear();
+
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    std::size_t size() const;
+    bool empty() const;
+
+    template <typename F>
+    void forEach(F f) const;
+
+    // Number of independently locked trees; a power of two
+    static const std::size_t SHARDS = 16;
+    // Lock-free attempts find() makes before it takes the shared lock
+    static const int OPTIMISTIC_TRIES = 4;
+    // Longest descent an optimistic find follows; an AVL tree that fits
+    // in memory is under 90 levels tall, so more means torn links
+    static const int MAX_DEPTH = 96;
+
+protected:
+    typedef AVLTree<Key, Value, Compare> Tree;
+    typedef AVLNode<Key, Value> NodeT;
+
+    static const bool OPTIMISTIC = std::is_trivially_copyable<Key>::value &&
+                                   std::is_trivially_copyable<Value>::value;
+
+    // The shard's tree, opened up for the optimistic descent
+    class ShardTree : public Tree
+    {
+    public:
+        using Tree::Tree;
+
+        const NodeT* root() const { return this->root_; }
+
+        // Frees the nodes into the pool but keeps its slabs, so that an
+        // optimistic find still walking them reads mapped memory
+        void clearKeepingSlabs()
+        {
+            this->clearHelper(this->root_);
+            this->root_ = NULL;
+            this->size_ = 0;
+            this->largest_ = NULL;
+        }
+    };
+
+    // One stripe, kept on its own cache lines so that locking it does
+    // not disturb its neighbours
+    struct alignas(64) Shard {
+        ShardTree tree;
+        mutable std::shared_mutex lock;
+        // even while the tree is unchanged, odd while a writer changes it
+        std::atomic<uint64_t> version{0};
+    };
+
+    // A shard's lock held exclusively, with the version odd meanwhile
+    class WriteLock
+    {
+    public:
+        explicit WriteLock(Shard& shard);
+        ~WriteLock();
+
+    private:
+        Shard& shard_;
+        std::unique_lock<std::shared_mutex> lock_;
+    };
+
+    Shard& shardOf(const Key& key);
+    const Shard& shardOf(const Key& key) const;
+    void lockAll(std::vector<std::shared_lock<std::shared_mutex> >& locks) const;
+    bool optimisticFind(const Shard& shard, const Key& key, Value* value, bool& found) const;
+    bool lookup(const Key& key, Value* value) const;
+
+    Shard shards_[SHARDS];
+    Hash hash_;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the ConcurrentAVLTree class.
+  -----------------------------------------
+*/
+
+template <typename Key, typename Value, typename Compare, typename Hash>
+ConcurrentAVLTree<Key, Value, Compare, Hash>::ConcurrentAVLTree()
+{
+
+}
+
+/**
+* An empty map ordered by comp, with keys spread over the shards by hash.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+ConcurrentAVLTree<Key, Value, Compare, Hash>::ConcurrentAVLTree(const Compare& comp, const Hash& hash) :
+    hash_(hash)
+{
+    for (std::size_t i = 0; i < SHARDS; ++i) {
+        shards_[i].tree = ShardTree(comp);
+    }
+}
+
+/**
+* The shard holding key.  The hash is mixed first, as std::hash is the
+* identity for integers and would put runs of keys in few shards.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+typename ConcurrentAVLTree<Key, Value, Compare, Hash>::Shard&
+ConcurrentAVLTree<Key, Value, Compare, Hash>::shardOf(const Key& key)
+{
+    uint64_t h = static_cast<uint64_t>(hash_(key)) * 0x9E3779B97F4A7C15ull;
+    return shards_[(h >> 32) & (SHARDS - 1)];
+}
+
+template <typename Key, typename Value, typename Compare, typename Hash>
+const typename ConcurrentAVLTree<Key, Value, Compare, Hash>::Shard&
+ConcurrentAVLTree<Key, Value, Compare, Hash>::shardOf(const Key& key) const
+{
+    return const_cast<ConcurrentAVLTree*>(this)->shardOf(key);
+}
+
+/**
+* Takes every shard's lock shared, always in the same order.  Writers
+* only ever hold one lock, so this cannot deadlock with them.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+void ConcurrentAVLTree<Key, Value, Compare, Hash>::lockAll(
+    std::vector<std::shared_lock<std::shared_mutex> >& locks) const
+{
+    locks.reserve(SHARDS);
+    for (std::size_t i = 0; i < SHARDS; ++i) {
+        locks.emplace_back(shards_[i].lock);
+    }
+}
+
+/**
+* Takes the lock and makes the version odd.  The fence keeps the tree's
+* changes from becoming visible before the odd version does.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+ConcurrentAVLTree<Key, Value, Compare, Hash>::WriteLock::WriteLock(Shard& shard) :
+    shard_(shard),
+    lock_(shard.lock)
+{
+    shard_.version.store(shard_.version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+* Makes the version even again, publishing the changes, then unlocks;
+* also when the change threw.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+ConcurrentAVLTree<Key, Value, Compare, Hash>::WriteLock::~WriteLock()
+{
+    shard_.version.store(shard_.version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/**
+* Inserts or replaces an item.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+void ConcurrentAVLTree<Key, Value, Compare, Hash>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Shard& shard = shardOf(keyValuePair.first);
+    WriteLock lock(shard);
+    shard.tree.insert(keyValuePair);
+}
+
+template <typename Key, typename Value, typename Compare, typename Hash>
+void ConcurrentAVLTree<Key, Value, Compare, Hash>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+    Shard& shard = shardOf(keyValuePair.first);
+    WriteLock lock(shard);
+    shard.tree.insert(std::move(keyValuePair));
+}
+
+/**
+* Removes key.  Returns false if it was not there.  The shard's size is
+* exact and O(1) to read, so comparing it saves a second descent.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+bool ConcurrentAVLTree<Key, Value, Compare, Hash>::remove(const Key& key)
+{
+    Shard& shard = shardOf(key);
+    WriteLock lock(shard);
+    std::size_t before = shard.tree.size();
+    shard.tree.remove(key);
+    return shard.tree.size() != before;
+}
+
+/**
+* Empties the shards one at a time; an insert racing with clear() may
+* survive it.  The shards keep their slabs for the nodes to come.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+void ConcurrentAVLTree<Key, Value, Compare, Hash>::clear()
+{
+    for (std::size_t i = 0; i < SHARDS; ++i) {
+        WriteLock lock(shards_[i]);
+        shards_[i].tree.clearKeepingSlabs();
+    }
+}
+
+/**
+* Copies the value stored with key into value.  Returns false, leaving
+* value alone, if key is not there.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+bool ConcurrentAVLTree<Key, Value, Compare, Hash>::find(const Key& key, Value& value) const
+{
+    return lookup(key, &value);
+}
+
+template <typename Key, typename Value, typename Compare, typename Hash>
+bool ConcurrentAVLTree<Key, Value, Compare, Hash>::contains(const Key& key) const
+{
+    return lookup(key, NULL);
+}
+
+/**
+* find() and contains(), with value NULL for the latter: optimistically
+* first, then under the shared lock.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+bool ConcurrentAVLTree<Key, Value, Compare, Hash>::lookup(const Key& key, Value* value) const
+{
+    const Shard& shard = shardOf(key);
+    if (OPTIMISTIC) {
+        bool found;
+        for (int i = 0; i < OPTIMISTIC_TRIES; ++i) {
+            if (optimisticFind(shard, key, value, found)) return found;
+        }
+    }
+    std::shared_lock<std::shared_mutex> lock(shard.lock);
+    typename Tree::const_iterator it = shard.tree.find(key);
+    if (it == shard.tree.end()) return false;
+    if (value != NULL) *value = it->second;
+    return true;
+}
+
+/**
+* One lock-free try at a lookup, descending with one comparison per
+* level as BinarySearchTree::findSlot() does.  Returns false if a writer
+* was at work on the shard, and the answer in found (and the value, if
+* asked for) otherwise.  The value is copied out byte for byte before
+* the version is checked again, as a torn one is thrown away unseen.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+bool ConcurrentAVLTree<Key, Value, Compare, Hash>::optimisticFind(const Shard& shard, const Key& key,
+    Value* value, bool& found) const
+{
+    uint64_t version = shard.version.load(std::memory_order_acquire);
+    if (version & 1) return false;
+
+    Compare comp = shard.tree.key_comp();
+    const NodeT* candidate = NULL;
+    const NodeT* n = shard.tree.root();
+    for (int depth = 0; n != NULL; ++depth) {
+        if (depth == MAX_DEPTH) return false;
+        if (comp(key, n->getKey())) {
+            n = n->getLeft();
+        } else {
+            candidate = n;
+            n = n->getRight();
+        }
+    }
+    bool hit = candidate != NULL && !comp(candidate->getKey(), key);
+    unsigned char copy[sizeof(Value)];
+    if (hit && value != NULL) std::memcpy(copy, &candidate->getValue(), sizeof(Value));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (shard.version.load(std::memory_order_relaxed) != version) return false;
+    if (hit && value != NULL) std::memcpy(static_cast<void*>(value), copy, sizeof(Value));
+    found = hit;
+    return true;
+}
+
+/**
+* The shards' sizes are kept exactly by insert and remove, so summing
+* them never has to count.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+std::size_t ConcurrentAVLTree<Key, Value, Compare, Hash>::size() const
+{
+    std::vector<std::shared_lock<std::shared_mutex> > locks;
+    lockAll(locks);
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < SHARDS; ++i) {
+        total += shards_[i].tree.size();
+    }
+    return total;
+}
+
+template <typename Key, typename Value, typename Compare, typename Hash>
+bool ConcurrentAVLTree<Key, Value, Compare, Hash>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* Calls f on every item in key order, holding off writers (but not other
+* readers) until it returns.  The shards are merged through a heap of
+* their next items, O(log SHARDS) comparisons per item.
+*/
+template <typename Key, typename Value, typename Compare, typename Hash>
+template <typename F>
+void ConcurrentAVLTree<Key, Value, Compare, Hash>::forEach(F f) const
+{
+    typedef std::pair<typename Tree::const_iterator, typename Tree::const_iterator> Cursor;
+    std::vector<std::shared_lock<std::shared_mutex> > locks;
+    lockAll(locks);
+
+    Compare comp = shards_[0].tree.key_comp();
+    // a max-heap under "later", so the front is the smallest next key
+    auto later = [&comp](const Cursor& a, const Cursor& b) { return comp(b.first->first, a.first->first); };
+    std::vector<Cursor> heads;
+    for (std::size_t i = 0; i < SHARDS; ++i) {
+        if (!shards_[i].tree.empty()) {
+            heads.push_back(Cursor(shards_[i].tree.begin(), shards_[i].tree.end()));
+        }
+    }
+    std::make_heap(heads.begin(), heads.end(), later);
+    while (!heads.empty()) {
+        std::pop_heap(heads.begin(), heads.end(), later);
+        Cursor& next = heads.back();
+        f(*next.first);
+        if (++next.first == next.second) {
+            heads.pop_back();
+        } else {
+            std::push_heap(heads.begin(), heads.end(), later);
+        }
+    }
+}
+
+/*
+  ---------------------------------------
+  End implementations for the ConcurrentAVLTree class.
+  ---------------------------------------
+*/
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef FROZEN_TREE_H
+#define FROZEN_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Number of keys in block that compare less than key: a branch-free
+ * count over a whole block of FrozenTree::BLOCK keys.
+ */
+template <typename Key, typename Compare>
+std::size_t countLess(const Key* block, const Key& key, const Compare& comp, std::size_t blockSize)
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < blockSize; ++i) {
+        count += comp(block[i], key);
+    }
+    return count;
+}
+
+#if defined(__SSE2__)
+/**
+* SIMD kernels for blocks of 16 integral keys under std::less.  Unsigned
+* keys are offset by bias so that the signed vector compares order them.
+*/
+inline std::size_t countLess16(const void* block, uint16_t key, uint16_t bias)
+{
+    const __m128i* p = static_cast<const __m128i*>(block);
+    __m128i b = _mm_set1_epi16(static_cast<short>(bias));
+    __m128i x = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(key)), b);
+    __m128i lt0 = _mm_cmplt_epi16(_mm_xor_si128(_mm_loadu_si128(p), b), x);
+    __m128i lt1 = _mm_cmplt_epi16(_mm_xor_si128(_mm_loadu_si128(p + 1), b), x);
+    return __builtin_popcount(_mm_movemask_epi8(_mm_packs_epi16(lt0, lt1)));
+}
+
+inline std::size_t countLess32(const void* block, uint32_t key, uint32_t bias)
+{
+    const __m128i* p = static_cast<const __m128i*>(block);
+    __m128i b = _mm_set1_epi32(static_cast<int>(bias));
+    __m128i x = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(key)), b);
+    __m128i lt[4];
+    for (int i = 0; i < 4; ++i) {
+        lt[i] = _mm_cmplt_epi32(_mm_xor_si128(_mm_loadu_si128(p + i), b), x);
+    }
+    __m128i packed = _mm_packs_epi16(_mm_packs_epi32(lt[0], lt[1]), _mm_packs_epi32(lt[2], lt[3]));
+    return __builtin_popcount(_mm_movemask_epi8(packed));
+}
+
+inline std::size_t countLess(const uint16_t* block, const uint16_t& key, const std::less<uint16_t>&, std::size_t)
+{
+    return countLess16(block, key, 0x8000);
+}
+
+inline std::size_t countLess(const int16_t* block, const int16_t& key, const std::less<int16_t>&, std::size_t)
+{
+    return countLess16(block, key, 0);
+}
+
+inline std::size_t countLess(const uint32_t* block, const uint32_t& key, const std::less<uint32_t>&, std::size_t)
+{
+    return countLess32(block, key, 0x80000000u);
+}
+
+inline std::size_t countLess(const int32_t* block, const int32_t& key, const std::less<int32_t>&, std::size_t)
+{
+    return countLess32(block, key, 0);
+}
+#endif
+
+#if defined(__AVX2__)
+inline std::size_t countLess64(const void* block, uint64_t key, uint64_t bias)
+{
+    const __m256i* p = static_cast<const __m256i*>(block);
+    __m256i b = _mm256_set1_epi64x(static_cast<long long>(bias));
+    __m256i x = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(key)), b);
+    std::size_t count = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m256i gt = _mm256_cmpgt_epi64(x, _mm256_xor_si256(_mm256_loadu_si256(p + i), b));
+        count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(gt)));
+    }
+    return count;
+}
+
+inline std::size_t countLess(const uint64_t* block, const uint64_t& key, const std::less<uint64_t>&, std::size_t)
+{
+    return countLess64(block, key, 0x8000000000000000ull);
+}
+
+inline std::size_t countLess(const int64_t* block, const int64_t& key, const std::less<int64_t>&, std::size_t)
+{
+    return countLess64(block, key, 0);
+}
+#endif
+
+/**
+ * An immutable sorted map built once, e.g. by BinarySearchTree::freeze(),
+ * and then only read.
+ *
+ * Items sit in one sorted array, so iteration is a pointer walk.  Keys
+ * are copied into blocks of BLOCK, and the last key of every block goes
+ * into an index kept in Eytzinger (breadth-first) order: the children of
+ * slot k are 2k and 2k + 1, so the top levels share a few cache lines
+ * and the 16 slots four levels down from k, 16k to 16k + 15, are
+ * adjacent and prefetched ahead of the search whatever the key size.  A
+ * lookup descends the index without branching on the comparison, then
+ * counts the keys below it in one block.  For 16, 32 and 64 bit integers
+ * under std::less the count is a SIMD compare (SSE2, or AVX2 for 64 bits
+ * when built with -mavx2).
+ *
+ * The blocks hold a second copy of every key, next to the one in its
+ * item, so that a block is contiguous for the count.  That is cheap for
+ * the integer keys the SIMD count serves, but doubles the key storage
+ * of large keys such as std::string, for which a BinarySearchTree or
+ * MappedTree may be the better read-only map.
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class FrozenTree
+{
+public:
+    typedef const std::pair<const Key, Value>* iterator;
+
+    FrozenTree();
+    template<typename InputIt>
+    FrozenTree(InputIt first, std::size_t n, const Compare& comp = Compare());
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+    Compare key_comp() const;
+    bool empty() const;
+    std::size_t size() const;
+
+protected:
+    // Keys per block; 16 keys fill one or two SIMD compares
+    static const std::size_t BLOCK = 16;
+    // Levels of the index prefetched ahead, and the slots on that level
+    // below any one slot; they are adjacent, so a key size up to 4 bytes
+    // puts them in one cache line and up to 8 bytes in at most two
+    static const std::size_t PREFETCH_LEVELS = 4;
+    static const std::size_t PREFETCH_SLOTS = std::size_t(1) << PREFETCH_LEVELS;
+
+    std::size_t lowerBoundIndex(const Key& key) const;
+    static std::size_t firstSlot(std::size_t slots);
+    static std::size_t nextSlot(std::size_t k, std::size_t slots);
+
+    std::vector<std::pair<const Key, Value> > items_;
+    // Sorted keys, a copy of those in items_, padded with the largest
+    // one to whole blocks
+    std::vector<Key> keys_;
+    // Eytzinger index from slot 1: last key of a block, and its offset
+    std::vector<Key> index_;
+    std::vector<std::size_t> blockStart_;
+    Compare comp_;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the FrozenTree class.
+  -----------------------------------------
+*/
+
+template <typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree()
+{
+
+}
+
+/**
+* Builds from n items read from first, which must be in strictly
+* increasing key order.
+*/
+template <typename Key, typename Value, typename Compare>
+template<typename InputIt>
+FrozenTree<Key, Value, Compare>::FrozenTree(InputIt first, std::size_t n, const Compare& comp) :
+    comp_(comp)
+{
+    if (n == 0) return;
+    std::size_t blocks = (n + BLOCK - 1) / BLOCK;
+    items_.reserve(n);
+    keys_.reserve(blocks * BLOCK);
+    for (std::size_t i = 0; i < n; ++i, ++first) {
+        items_.emplace_back(*first);
+        keys_.push_back(items_.back().first);
+    }
+    keys_.resize(blocks * BLOCK, keys_.back());
+
+    // an in-order walk of the slots visits the blocks in order
+    index_.assign(blocks + 1, keys_.back());
+    blockStart_.assign(blocks + 1, 0);
+    std::size_t k = firstSlot(blocks);
+    for (std::size_t b = 0; b < blocks; ++b, k = nextSlot(k, blocks)) {
+        index_[k] = keys_[b * BLOCK + BLOCK - 1];
+        blockStart_[k] = b * BLOCK;
+    }
+}
+
+/**
+* Slot of the leftmost index entry.
+*/
+template <typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::firstSlot(std::size_t slots)
+{
+    std::size_t k = 1;
+    while (2 * k <= slots) {
+        k *= 2;
+    }
+    return k;
+}
+
+/**
+* In-order successor of slot k: the leftmost slot of the right subtree,
+* or else the first ancestor reached from a left child.
+*/
+template <typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::nextSlot(std::size_t k, std::size_t slots)
+{
+    if (2 * k + 1 <= slots) {
+        k = 2 * k + 1;
+        while (2 * k <= slots) {
+            k *= 2;
+        }
+        return k;
+    }
+    return k >> (__builtin_ctzll(~static_cast<unsigned long long>(k)) + 1);
+}
+
+/**
+* Position in items_ of the first key not less than key, or size().
+* The descent records each step right as a 1 bit in k; a trailing run
+* of right steps, and the left step above it, are undone to land on the
+* last slot where the search went left.
+*/
+template <typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::lowerBoundIndex(const Key& key) const
+{
+    const std::size_t blocks = index_.size() == 0 ? 0 : index_.size() - 1;
+    const Key* index = index_.data();
+    std::size_t k = 1;
+    while (k <= blocks) {
+        const Key* ahead = index + k * PREFETCH_SLOTS;
+        __builtin_prefetch(ahead);
+        if (PREFETCH_SLOTS * sizeof(Key) > 64) __builtin_prefetch(ahead + PREFETCH_SLOTS - 1);
+        k = 2 * k + comp_(index[k], key);
+    }
+    k >>= __builtin_ctzll(~static_cast<unsigned long long>(k)) + 1;
+    if (k == 0) return items_.size();
+    std::size_t start = blockStart_[k];
+    return start + countLess(keys_.data() + start, key, comp_, BLOCK);
+}
+
+template <typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::begin() const
+{
+    return items_.data();
+}
+
+template <typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::end() const
+{
+    return items_.data() + items_.size();
+}
+
+template <typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::find(const Key& key) const
+{
+    std::size_t i = lowerBoundIndex(key);
+    if (i == items_.size() || comp_(key, keys_[i])) return end();
+    return begin() + i;
+}
+
+template <typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return begin() + lowerBoundIndex(key);
+}
+
+/**
+* Keys are unique, so the upper bound is at most one past the lower.
+*/
+template <typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::iterator FrozenTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    std::size_t i = lowerBoundIndex(key);
+    if (i < items_.size() && !comp_(key, keys_[i])) ++i;
+    return begin() + i;
+}
+
+template <typename Key, typename Value, typename Compare>
+Value const & FrozenTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template <typename Key, typename Value, typename Compare>
+Compare FrozenTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+template <typename Key, typename Value, typename Compare>
+bool FrozenTree<Key, Value, Compare>::empty() const
+{
+    return items_.empty();
+}
+
+template <typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::size() const
+{
+    return items_.size();
+}
+
+/*
+  ---------------------------------------
+  End implementations for the FrozenTree class.
+  ---------------------------------------
+*/
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <type_traits>
+
+/**
+ * A slab allocator for search tree nodes.
+ *
+ * Nodes are carved out of contiguous slabs instead of one malloc per node,
+ * removed nodes are recycled through an intrusive free list, and release()
+ * hands every slab back at once when no node is outstanding.
+ *
+ * Copies of a pool share the same slabs, so (as for any standard allocator)
+ * a copy may free what the original allocated.  A pool is not thread safe.
+ */
+template <typename T>
+class NodePool
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef std::size_t size_type;
+
+    NodePool();
+
+    T* allocate(std::size_t n);
+    void deallocate(T* p, std::size_t n);
+    void release();
+
+    std::size_t slabCount() const;
+
+    bool operator==(const NodePool<T>& rhs) const;
+    bool operator!=(const NodePool<T>& rhs) const;
+
+private:
+    // A free cell reuses the node's own storage as the free list link.
+    union Cell {
+        Cell* next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    // Slabs are linked through a header placed in front of the cells.
+    struct Slab {
+        Slab* next;
+        std::size_t cells;
+    };
+
+    struct Arena {
+        Arena();
+        ~Arena();
+        void freeSlabs();
+
+        Cell* free_;
+        Cell* next_;
+        Cell* end_;
+        Slab* slabs_;
+        std::size_t slabCount_;
+        std::size_t live_;
+    };
+
+    static const std::size_t MIN_SLAB_CELLS = 32;
+    static const std::size_t MAX_SLAB_CELLS = 8192;
+
+    static std::size_t cellOffset();
+    void grow();
+
+    std::shared_ptr<Arena> arena_;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the NodePool class.
+  -----------------------------------------
+*/
+
+template <typename T>
+NodePool<T>::Arena::Arena() :
+    free_(NULL),
+    next_(NULL),
+    end_(NULL),
+    slabs_(NULL),
+    slabCount_(0),
+    live_(0)
+{
+
+}
+
+template <typename T>
+NodePool<T>::Arena::~Arena()
+{
+    freeSlabs();
+}
+
+template <typename T>
+void NodePool<T>::Arena::freeSlabs()
+{
+    while (slabs_ != NULL) {
+        Slab* next = slabs_->next;
+        ::operator delete(slabs_);
+        slabs_ = next;
+    }
+    free_ = next_ = end_ = NULL;
+    slabCount_ = 0;
+}
+
+/**
+* Default constructor, which starts a pool with no slabs.
+*/
+template <typename T>
+NodePool<T>::NodePool() :
+    arena_(std::make_shared<Arena>())
+{
+
+}
+
+/**
+* Byte offset of the first cell in a slab, past the header.
+*/
+template <typename T>
+std::size_t NodePool<T>::cellOffset()
+{
+    std::size_t align = alignof(Cell);
+    return (sizeof(Slab) + align - 1) / align * align;
+}
+
+/**
+* Adds a new slab, doubling the slab size up to MAX_SLAB_CELLS so that
+* small trees do not reserve a large block.
+*/
+template <typename T>
+void NodePool<T>::grow()
+{
+    Arena& a = *arena_;
+    std::size_t cells = MIN_SLAB_CELLS;
+    if (a.slabs_ != NULL) {
+        cells = a.slabs_->cells * 2;
+        if (cells > MAX_SLAB_CELLS) cells = MAX_SLAB_CELLS;
+    }
+    Slab* slab = static_cast<Slab*>(::operator new(cellOffset() + cells * sizeof(Cell)));
+    slab->next = a.slabs_;
+    slab->cells = cells;
+    a.slabs_ = slab;
+    ++a.slabCount_;
+    a.next_ = reinterpret_cast<Cell*>(reinterpret_cast<char*>(slab) + cellOffset());
+    a.end_ = a.next_ + cells;
+}
+
+/**
+* Returns storage for one node, preferring a recycled cell, then the
+* unused tail of the current slab.  Array requests bypass the pool.
+*/
+template <typename T>
+T* NodePool<T>::allocate(std::size_t n)
+{
+    if (n != 1) {
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    Arena& a = *arena_;
+    Cell* cell = a.free_;
+    if (cell != NULL) {
+        a.free_ = cell->next;
+    } else {
+        if (a.next_ == a.end_) grow();
+        cell = a.next_++;
+    }
+    ++a.live_;
+    return reinterpret_cast<T*>(cell);
+}
+
+/**
+* Returns a node's storage to the free list.
+*/
+template <typename T>
+void NodePool<T>::deallocate(T* p, std::size_t n)
+{
+    if (n != 1) {
+        ::operator delete(p);
+        return;
+    }
+    Arena& a = *arena_;
+    Cell* cell = reinterpret_cast<Cell*>(p);
+    cell->next = a.free_;
+    a.free_ = cell;
+    --a.live_;
+}
+
+/**
+* Frees every slab at once.  Does nothing while nodes are still
+* outstanding, e.g. when another copy of the pool still uses them.
+*/
+template <typename T>
+void NodePool<T>::release()
+{
+    if (arena_->live_ == 0) {
+        arena_->freeSlabs();
+    }
+}
+
+/**
+* Returns the number of slabs currently held.
+*/
+template <typename T>
+std::size_t NodePool<T>::slabCount() const
+{
+    return arena_->slabCount_;
+}
+
+/**
+* Pools are equal when they share slabs and can free each other's nodes.
+*/
+template <typename T>
+bool NodePool<T>::operator==(const NodePool<T>& rhs) const
+{
+    return arena_ == rhs.arena_;
+}
+
+template <typename T>
+bool NodePool<T>::operator!=(const NodePool<T>& rhs) const
+{
+    return arena_ != rhs.arena_;
+}
+
+/*
+  ---------------------------------------
+  End implementations for the NodePool class.
+  ---------------------------------------
+*/
+
+/**
+* Lets a tree hand its slabs back on clear().  Allocators other
+* than NodePool free per node, so there is nothing left to release.
+*/
+template <typename Alloc>
+void releaseSlabs(Alloc&)
+{
+
+}
+
+template <typename T>
+void releaseSlabs(NodePool<T>& pool)
+{
+    pool.release();
+}
+
+#endif
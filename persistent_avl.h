@@ -0,0 +1,641 @@
+#ifndef PERSISTENT_AVL_H
+#define PERSISTENT_AVL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * An immutable AVL tree node shared between versions of a
+ * PersistentAVLTree.  Nodes have no parent pointer, since one node may
+ * sit in many versions, and are freed when the last version holding
+ * them lets go.  The reference count is atomic, so versions may be
+ * released on any thread.
+ */
+template <typename Key, typename Value>
+class PersistentNode
+{
+public:
+    PersistentNode(const std::pair<const Key, Value>& item,
+                   const PersistentNode<Key, Value>* left, const PersistentNode<Key, Value>* right);
+
+    const std::pair<const Key, Value>& getItem() const;
+    const Key& getKey() const;
+    const Value& getValue() const;
+    const PersistentNode<Key, Value>* getLeft() const;
+    const PersistentNode<Key, Value>* getRight() const;
+    int getHeight() const;
+
+    static int heightOf(const PersistentNode<Key, Value>* n);
+    static const PersistentNode<Key, Value>* retain(const PersistentNode<Key, Value>* n);
+    static void release(const PersistentNode<Key, Value>* n);
+
+private:
+    std::pair<const Key, Value> item_;
+    const PersistentNode<Key, Value>* left_;
+    const PersistentNode<Key, Value>* right_;
+    int8_t height_;
+    mutable std::atomic<std::size_t> refs_;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the PersistentNode class.
+  -----------------------------------------
+*/
+
+/**
+* Makes a node holding one reference, which the caller owns.  The node
+* takes over the caller's references to left and right.
+*/
+template <typename Key, typename Value>
+PersistentNode<Key, Value>::PersistentNode(const std::pair<const Key, Value>& item,
+    const PersistentNode<Key, Value>* left, const PersistentNode<Key, Value>* right) :
+    item_(item),
+    left_(left),
+    right_(right),
+    height_(1 + std::max(heightOf(left), heightOf(right))),
+    refs_(1)
+{
+
+}
+
+template <typename Key, typename Value>
+const std::pair<const Key, Value>& PersistentNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template <typename Key, typename Value>
+const Key& PersistentNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template <typename Key, typename Value>
+const Value& PersistentNode<Key, Value>::getValue() const
+{
+    return item_.second;
+}
+
+template <typename Key, typename Value>
+const PersistentNode<Key, Value>* PersistentNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+template <typename Key, typename Value>
+const PersistentNode<Key, Value>* PersistentNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+template <typename Key, typename Value>
+int PersistentNode<Key, Value>::getHeight() const
+{
+    return height_;
+}
+
+/**
+* Height of the subtree at n; 0 for an empty one.
+*/
+template <typename Key, typename Value>
+int PersistentNode<Key, Value>::heightOf(const PersistentNode<Key, Value>* n)
+{
+    return n == NULL ? 0 : n->height_;
+}
+
+/**
+* Takes another reference to n and returns it.
+*/
+template <typename Key, typename Value>
+const PersistentNode<Key, Value>* PersistentNode<Key, Value>::retain(const PersistentNode<Key, Value>* n)
+{
+    if (n != NULL) {
+        n->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return n;
+}
+
+/**
+* Drops a reference to n, freeing it and releasing its children when it
+* was the last one.  The recursion only goes as deep as the tree.
+*/
+template <typename Key, typename Value>
+void PersistentNode<Key, Value>::release(const PersistentNode<Key, Value>* n)
+{
+    if (n == NULL || n->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    release(n->left_);
+    release(n->right_);
+    delete n;
+}
+
+/*
+  ---------------------------------------
+  End implementations for the PersistentNode class.
+  ---------------------------------------
+*/
+
+/**
+ * A persistent AVL tree: insert and remove copy the O(log n) nodes on the
+ * path to the change and share the rest, so every earlier version stays
+ * intact.  snapshot() captures the current version in O(1); readers can
+ * then search and iterate it without locks for as long as they hold it,
+ * while a writer keeps changing the tree.  Versions are reclaimed by
+ * reference counting when the last snapshot of them goes away.
+ *
+ * One thread may write at a time.  snapshot() may be called from any
+ * number of threads alongside it; it only holds a lock for the instant it
+ * takes to pin the current root.
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class PersistentAVLTree
+{
+public:
+    typedef PersistentNode<Key, Value> NodeT;
+
+    /**
+    * An immutable version of the tree.  Copies share the version.
+    */
+    class Snapshot
+    {
+    public:
+        /**
+        * An in-order iterator.  Without parent pointers it keeps the path
+        * from the root on a stack, O(log n) entries.
+        */
+        class iterator
+        {
+        public:
+            iterator();
+
+            const std::pair<const Key, Value>& operator*() const;
+            const std::pair<const Key, Value>* operator->() const;
+
+            bool operator==(const iterator& rhs) const;
+            bool operator!=(const iterator& rhs) const;
+
+            iterator& operator++();
+
+        protected:
+            friend class Snapshot;
+            explicit iterator(const NodeT* root);
+            void pushLeft(const NodeT* n);
+            std::vector<const NodeT*> path_;
+        };
+
+        Snapshot();
+        Snapshot(const Snapshot& other);
+        Snapshot& operator=(const Snapshot& other);
+        ~Snapshot();
+
+        iterator begin() const;
+        iterator end() const;
+        const Value* find(const Key& key) const;
+        std::size_t size() const;
+        bool empty() const;
+
+    protected:
+        friend class PersistentAVLTree<Key, Value, Compare>;
+        Snapshot(const NodeT* root, std::size_t size, const Compare& comp);
+
+        const NodeT* root_;
+        std::size_t size_;
+        Compare comp_;
+    };
+
+    PersistentAVLTree();
+    explicit PersistentAVLTree(const Compare& comp);
+    ~PersistentAVLTree();
+    PersistentAVLTree(const PersistentAVLTree&) = delete;
+    PersistentAVLTree& operator=(const PersistentAVLTree&) = delete;
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    Snapshot snapshot() const;
+    std::size_t size() const;
+    bool empty() const;
+
+protected:
+    static const NodeT* findNode(const NodeT* root, const Key& key, const Compare& comp);
+    const NodeT* insertHelper(const NodeT* n, const std::pair<const Key, Value>& keyValuePair, bool& added) const;
+    const NodeT* removeHelper(const NodeT* n, const Key& key) const;
+    const NodeT* removeLargest(const NodeT* n) const;
+    static const NodeT* balance(const std::pair<const Key, Value>& item, const NodeT* left, const NodeT* right);
+    void publish(const NodeT* root, std::size_t size);
+
+    // The writer's current version; reads by other threads hold rootLock_
+    const NodeT* root_;
+    std::size_t size_;
+    Compare comp_;
+    mutable std::mutex rootLock_;
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the PersistentAVLTree::Snapshot class.
+  -----------------------------------------
+*/
+
+template <typename Key, typename Value, typename Compare>
+PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator::iterator()
+{
+
+}
+
+/**
+* Starts at the smallest item of the tree at root.
+*/
+template <typename Key, typename Value, typename Compare>
+PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator::iterator(const NodeT* root)
+{
+    path_.reserve(NodeT::heightOf(root));
+    pushLeft(root);
+}
+
+/**
+* Pushes n and its chain of left children.
+*/
+template <typename Key, typename Value, typename Compare>
+void PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator::pushLeft(const NodeT* n)
+{
+    for (; n != NULL; n = n->getLeft()) {
+        path_.push_back(n);
+    }
+}
+
+template <typename Key, typename Value, typename Compare>
+const std::pair<const Key, Value>&
+PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator::operator*() const
+{
+    return path_.back()->getItem();
+}
+
+template <typename Key, typename Value, typename Compare>
+const std::pair<const Key, Value>*
+PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator::operator->() const
+{
+    return &(path_.back()->getItem());
+}
+
+template <typename Key, typename Value, typename Compare>
+bool PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator::operator==(const iterator& rhs) const
+{
+    if (path_.empty() || rhs.path_.empty()) {
+        return path_.empty() == rhs.path_.empty();
+    }
+    return path_.back() == rhs.path_.back();
+}
+
+template <typename Key, typename Value, typename Compare>
+bool PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* The next item is the smallest in the right subtree, or else the
+* nearest ancestor still on the stack.
+*/
+template <typename Key, typename Value, typename Compare>
+typename PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator&
+PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator::operator++()
+{
+    const NodeT* n = path_.back();
+    path_.pop_back();
+    pushLeft(n->getRight());
+    return *this;
+}
+
+/**
+* An empty snapshot.
+*/
+template <typename Key, typename Value, typename Compare>
+PersistentAVLTree<Key, Value, Compare>::Snapshot::Snapshot() :
+    root_(NULL),
+    size_(0)
+{
+
+}
+
+/**
+* Takes over a reference to root.
+*/
+template <typename Key, typename Value, typename Compare>
+PersistentAVLTree<Key, Value, Compare>::Snapshot::Snapshot(const NodeT* root, std::size_t size, const Compare& comp) :
+    root_(root),
+    size_(size),
+    comp_(comp)
+{
+
+}
+
+template <typename Key, typename Value, typename Compare>
+PersistentAVLTree<Key, Value, Compare>::Snapshot::Snapshot(const Snapshot& other) :
+    root_(NodeT::retain(other.root_)),
+    size_(other.size_),
+    comp_(other.comp_)
+{
+
+}
+
+template <typename Key, typename Value, typename Compare>
+typename PersistentAVLTree<Key, Value, Compare>::Snapshot&
+PersistentAVLTree<Key, Value, Compare>::Snapshot::operator=(const Snapshot& other)
+{
+    const NodeT* old = root_;
+    root_ = NodeT::retain(other.root_);
+    size_ = other.size_;
+    comp_ = other.comp_;
+    NodeT::release(old);
+    return *this;
+}
+
+/**
+* Lets go of the version; nodes no other version shares are freed.
+*/
+template <typename Key, typename Value, typename Compare>
+PersistentAVLTree<Key, Value, Compare>::Snapshot::~Snapshot()
+{
+    NodeT::release(root_);
+}
+
+template <typename Key, typename Value, typename Compare>
+typename PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator
+PersistentAVLTree<Key, Value, Compare>::Snapshot::begin() const
+{
+    return iterator(root_);
+}
+
+template <typename Key, typename Value, typename Compare>
+typename PersistentAVLTree<Key, Value, Compare>::Snapshot::iterator
+PersistentAVLTree<Key, Value, Compare>::Snapshot::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns the value stored with key in this version, or NULL.
+*/
+template <typename Key, typename Value, typename Compare>
+const Value* PersistentAVLTree<Key, Value, Compare>::Snapshot::find(const Key& key) const
+{
+    const NodeT* n = findNode(root_, key, comp_);
+    return n == NULL ? NULL : &n->getValue();
+}
+
+template <typename Key, typename Value, typename Compare>
+std::size_t PersistentAVLTree<Key, Value, Compare>::Snapshot::size() const
+{
+    return size_;
+}
+
+template <typename Key, typename Value, typename Compare>
+bool PersistentAVLTree<Key, Value, Compare>::Snapshot::empty() const
+{
+    return root_ == NULL;
+}
+
+/*
+  ---------------------------------------
+  End implementations for the PersistentAVLTree::Snapshot class.
+  ---------------------------------------
+*/
+
+/*
+  -----------------------------------------
+  Begin implementations for the PersistentAVLTree class.
+  -----------------------------------------
+*/
+
+template <typename Key, typename Value, typename Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree() :
+    root_(NULL),
+    size_(0)
+{
+
+}
+
+template <typename Key, typename Value, typename Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree(const Compare& comp) :
+    root_(NULL),
+    size_(0),
+    comp_(comp)
+{
+
+}
+
+/**
+* Drops the current version.  Snapshots taken earlier stay valid.
+*/
+template <typename Key, typename Value, typename Compare>
+PersistentAVLTree<Key, Value, Compare>::~PersistentAVLTree()
+{
+    NodeT::release(root_);
+}
+
+/**
+* Inserts or replaces an item, copying the path from the root to it.
+* Writer only.
+*/
+template <typename Key, typename Value, typename Compare>
+void PersistentAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool added = false;
+    const NodeT* root = insertHelper(root_, keyValuePair, added);
+    publish(root, size_ + (added ? 1 : 0));
+}
+
+/**
+* Removes key, if present, copying the path from the root to it.
+* Writer only.
+*/
+template <typename Key, typename Value, typename Compare>
+void PersistentAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    if (findNode(root_, key, comp_) == NULL) return;
+    publish(removeHelper(root_, key), size_ - 1);
+}
+
+/**
+* Returns the current version in O(1).  Safe to call while the writer
+* is running.
+*/
+template <typename Key, typename Value, typename Compare>
+typename PersistentAVLTree<Key, Value, Compare>::Snapshot
+PersistentAVLTree<Key, Value, Compare>::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(rootLock_);
+    return Snapshot(NodeT::retain(root_), size_, comp_);
+}
+
+template <typename Key, typename Value, typename Compare>
+std::size_t PersistentAVLTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+template <typename Key, typename Value, typename Compare>
+bool PersistentAVLTree<Key, Value, Compare>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* Makes root the current version and drops the writer's hold on the old
+* one, which is freed unless a snapshot still holds it.
+*/
+template <typename Key, typename Value, typename Compare>
+void PersistentAVLTree<Key, Value, Compare>::publish(const NodeT* root, std::size_t size)
+{
+    const NodeT* old;
+    {
+        std::lock_guard<std::mutex> lock(rootLock_);
+        old = root_;
+        root_ = root;
+        size_ = size;
+    }
+    NodeT::release(old);
+}
+
+/**
+* Finds key with one comparison per level; see BinarySearchTree.
+*/
+template <typename Key, typename Value, typename Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::NodeT*
+PersistentAVLTree<Key, Value, Compare>::findNode(const NodeT* root, const Key& key, const Compare& comp)
+{
+    const NodeT* bound = NULL;
+    while (root != NULL) {
+        if (comp(root->getKey(), key)) {
+            root = root->getRight();
+        } else {
+            bound = root;
+            root = root->getLeft();
+        }
+    }
+    if (bound != NULL && !comp(key, bound->getKey())) return bound;
+    return NULL;
+}
+
+/**
+* Returns a new version of the subtree at n with the item inserted,
+* holding one reference.  Only the nodes on the path are new.
+*/
+template <typename Key, typename Value, typename Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::NodeT*
+PersistentAVLTree<Key, Value, Compare>::insertHelper(const NodeT* n,
+    const std::pair<const Key, Value>& keyValuePair, bool& added) const
+{
+    if (n == NULL) {
+        added = true;
+        return new NodeT(keyValuePair, NULL, NULL);
+    }
+    if (comp_(keyValuePair.first, n->getKey())) {
+        return balance(n->getItem(), insertHelper(n->getLeft(), keyValuePair, added),
+                       NodeT::retain(n->getRight()));
+    }
+    if (comp_(n->getKey(), keyValuePair.first)) {
+        return balance(n->getItem(), NodeT::retain(n->getLeft()),
+                       insertHelper(n->getRight(), keyValuePair, added));
+    }
+    // replace, the shape of the tree does not change
+    return new NodeT(keyValuePair, NodeT::retain(n->getLeft()), NodeT::retain(n->getRight()));
+}
+
+/**
+* Returns a new version of the subtree at n without key, which must be
+* in it.  A node with two children is replaced by its predecessor.
+*/
+template <typename Key, typename Value, typename Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::NodeT*
+PersistentAVLTree<Key, Value, Compare>::removeHelper(const NodeT* n, const Key& key) const
+{
+    if (comp_(key, n->getKey())) {
+        return balance(n->getItem(), removeHelper(n->getLeft(), key), NodeT::retain(n->getRight()));
+    }
+    if (comp_(n->getKey(), key)) {
+        return balance(n->getItem(), NodeT::retain(n->getLeft()), removeHelper(n->getRight(), key));
+    }
+    if (n->getLeft() == NULL) return NodeT::retain(n->getRight());
+    if (n->getRight() == NULL) return NodeT::retain(n->getLeft());
+    const NodeT* pred = n->getLeft();
+    while (pred->getRight() != NULL) {
+        pred = pred->getRight();
+    }
+    return balance(pred->getItem(), removeLargest(n->getLeft()), NodeT::retain(n->getRight()));
+}
+
+/**
+* Returns a new version of the subtree at n without its largest item.
+*/
+template <typename Key, typename Value, typename Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::NodeT*
+PersistentAVLTree<Key, Value, Compare>::removeLargest(const NodeT* n) const
+{
+    if (n->getRight() == NULL) return NodeT::retain(n->getLeft());
+    return balance(n->getItem(), NodeT::retain(n->getLeft()), removeLargest(n->getRight()));
+}
+
+/**
+* Makes a node for item over left and right, whose heights differ by at
+* most two, rotating as AVLTree does when they differ by two.  Takes over
+* the references to left and right.  Rotations build new nodes rather
+* than relinking, as the old ones may be shared.
+*/
+template <typename Key, typename Value, typename Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::NodeT*
+PersistentAVLTree<Key, Value, Compare>::balance(const std::pair<const Key, Value>& item,
+    const NodeT* left, const NodeT* right)
+{
+    int lHeight = NodeT::heightOf(left);
+    int rHeight = NodeT::heightOf(right);
+    const NodeT* top;
+    if (lHeight > rHeight + 1) {
+        const NodeT* ll = left->getLeft();
+        const NodeT* lr = left->getRight();
+        if (NodeT::heightOf(ll) >= NodeT::heightOf(lr)) {
+            // zig zig: rotate right
+            top = new NodeT(left->getItem(), NodeT::retain(ll),
+                            new NodeT(item, NodeT::retain(lr), right));
+        } else {
+            // zig zag: lr comes to the top
+            top = new NodeT(lr->getItem(),
+                            new NodeT(left->getItem(), NodeT::retain(ll), NodeT::retain(lr->getLeft())),
+                            new NodeT(item, NodeT::retain(lr->getRight()), right));
+        }
+        NodeT::release(left);
+    } else if (rHeight > lHeight + 1) {
+        const NodeT* rl = right->getLeft();
+        const NodeT* rr = right->getRight();
+        if (NodeT::heightOf(rr) >= NodeT::heightOf(rl)) {
+            // zig zig: rotate left
+            top = new NodeT(right->getItem(),
+                            new NodeT(item, left, NodeT::retain(rl)), NodeT::retain(rr));
+        } else {
+            // zig zag: rl comes to the top
+            top = new NodeT(rl->getItem(),
+                            new NodeT(item, left, NodeT::retain(rl->getLeft())),
+                            new NodeT(right->getItem(), NodeT::retain(rl->getRight()), NodeT::retain(rr)));
+        }
+        NodeT::release(right);
+    } else {
+        top = new NodeT(item, left, right);
+    }
+    return top;
+}
+
+/*
+  ---------------------------------------
+  End implementations for the PersistentAVLTree class.
+  ---------------------------------------
+*/
+
+#endif
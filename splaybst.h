@@ -0,0 +1,320 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include "bst.h"
+
+/**
+* A self-adjusting splay tree.  Every insert, emplace, try_emplace,
+* remove, find and operator[] on a non-const tree rotates the node it
+* reaches up to the root, so keys that are used often stay a few links
+* from the top: a run of m operations costs O(m log n) amortized.  Each
+* access pays for its rotations with writes, though: in bst-bench
+* splay it finds uniform keys about half as fast as AVLTree, is still
+* slower on Zipf-skewed lookups, and only draws level when 16 hot keys
+* take every lookup.  Lookups writing to the tree also means only the
+* const overloads of find() and operator[] (inherited, and not
+* splaying) are safe to call concurrently.  The
+* range queries (lower_bound, upper_bound, equal_range, range, select)
+* are inherited and leave the shape alone.
+* The plain Node carries no balance information, so NodeT defaults to it;
+* a SizedNode keeps rank() and select() working.
+*/
+template <class Key, class Value, class Compare = std::less<Key>,
+          class NodeT = Node<Key, Value>, class Alloc = NodePool<NodeT> >
+class SplayTree : public BinarySearchTree<Key, Value, Compare, NodeT, Alloc>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::iterator iterator;
+
+    SplayTree();
+    explicit SplayTree(const Compare& comp);
+    template<typename ForwardIt>
+    SplayTree(ForwardIt first, ForwardIt last, const Compare& comp = Compare());
+    SplayTree(SplayTree&& other);
+    SplayTree& operator=(SplayTree&& other);
+
+    using BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::insert;
+    using BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::find;
+    using BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::operator[];
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    virtual void remove(const Key& key);
+    iterator find(const Key& key);
+    Value& operator[](const Key& key);
+
+protected:
+    virtual void leafAdded(NodeT* n);
+    virtual void keyFound(NodeT* n);
+
+    // Add helper functions here
+		NodeT* search(const Key& key, NodeT*& last, bool& left);
+		NodeT* access(const Key& key);
+		void splay(NodeT* n);
+		void rotateUp(NodeT* n);
+};
+
+/*
+  -----------------------------------------
+  Begin implementations for the SplayTree class.
+  -----------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+SplayTree<Key, Value, Compare, NodeT, Alloc>::SplayTree()
+{
+
+}
+
+/**
+* Constructs an empty tree ordered by comp.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+SplayTree<Key, Value, Compare, NodeT, Alloc>::SplayTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>(comp)
+{
+
+}
+
+/**
+* Builds a balanced tree in linear time from a range sorted by key with
+* no duplicate keys; see BinarySearchTree::assign().  Splaying starts
+* from that shape.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+template<typename ForwardIt>
+SplayTree<Key, Value, Compare, NodeT, Alloc>::SplayTree(ForwardIt first, ForwardIt last, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>(first, last, comp)
+{
+
+}
+
+/**
+* Takes over other's nodes, leaving other empty.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+SplayTree<Key, Value, Compare, NodeT, Alloc>::SplayTree(SplayTree&& other) :
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>(std::move(other))
+{
+
+}
+
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+SplayTree<Key, Value, Compare, NodeT, Alloc>&
+SplayTree<Key, Value, Compare, NodeT, Alloc>::operator=(SplayTree&& other)
+{
+    BinarySearchTree<Key, Value, Compare, NodeT, Alloc>::operator=(std::move(other));
+    return *this;
+}
+
+/**
+* Inserts new_item, or overwrites the value if its key is already in the
+* tree, and splays its node to the root either way.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void SplayTree<Key, Value, Compare, NodeT, Alloc>::insert(const std::pair<const Key, Value>& new_item)
+{
+	NodeT* parent;
+	bool left;
+	NodeT* existing = search(new_item.first, parent, left);
+	if (existing != NULL) {
+		existing->setValue(new_item.second);
+		splay(existing);
+		return;
+	}
+	this->linkLeaf(parent, left, this->createNode(parent, new_item.first, new_item.second));
+}
+
+/**
+* Splays any insert path's new leaf n to the root.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void SplayTree<Key, Value, Compare, NodeT, Alloc>::leafAdded(NodeT* n)
+{
+	SubtreeSize<NodeT::TRACKS_SIZE>::updatePath(n->getParent());
+	splay(n);
+}
+
+/**
+* Splays n to the root when an inherited insert, emplace or try_emplace
+* finds its key already in the tree, so those count as accesses too.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void SplayTree<Key, Value, Compare, NodeT, Alloc>::keyFound(NodeT* n)
+{
+	splay(n);
+}
+
+/**
+* Removes key if it is present.  Its node is splayed to the root and
+* unlinked, and the largest node of the left subtree is splayed up to
+* take its place: having no right child, it adopts the right subtree
+* whole.  On a miss the last node searched is splayed instead.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void SplayTree<Key, Value, Compare, NodeT, Alloc>::remove(const Key& key)
+{
+	NodeT* target = access(key);
+	if (target == NULL) return;
+	this->removing(target);
+
+	NodeT* l = target->getLeft();
+	NodeT* r = target->getRight();
+	if (l == NULL) {
+		this->root_ = r;
+		if (r != NULL) r->setParent(NULL);
+	} else {
+		// splay within the detached left subtree
+		l->setParent(NULL);
+		NodeT* top = l;
+		while (top->getRight() != NULL) top = top->getRight();
+		splay(top);
+		top->setRight(r);
+		if (r != NULL) r->setParent(top);
+		SubtreeSize<NodeT::TRACKS_SIZE>::update(top);
+		this->root_ = top;
+	}
+	this->destroyNode(target);
+}
+
+/**
+* Returns an iterator to the item with key, or the end iterator, after
+* splaying the node found (or the last node searched) to the root.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+typename SplayTree<Key, Value, Compare, NodeT, Alloc>::iterator
+SplayTree<Key, Value, Compare, NodeT, Alloc>::find(const Key& key)
+{
+	return this->iteratorAt(access(key));
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key, splaying as find() does.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+Value& SplayTree<Key, Value, Compare, NodeT, Alloc>::operator[](const Key& key)
+{
+	NodeT* n = access(key);
+	if (n == NULL) throw std::out_of_range("Invalid key");
+	return n->getValue();
+}
+
+/**
+* Returns the node with key, or NULL with last set to the last node
+* visited and left to the side key would hang from it.  Unlike
+* findSlot() the descent stops at an equal key: splayed keys sit near
+* the root, and going on down to a leaf would throw that away.  Each
+* node costs one comparison to go left and a second, the other way
+* round, to tell going right from a match.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* SplayTree<Key, Value, Compare, NodeT, Alloc>::search(const Key& key, NodeT*& last, bool& left)
+{
+	last = NULL;
+	left = false;
+	NodeT* curr = this->root_;
+	while (curr != NULL) {
+		this->counter().count(&TreeStats::nodesVisited);
+		last = curr;
+		if (this->keyLess(key, curr->getKey())) {
+			left = true;
+			curr = curr->getLeft();
+		} else if (this->keyLess(curr->getKey(), key)) {
+			left = false;
+			curr = curr->getRight();
+		} else {
+			return curr;
+		}
+	}
+	return NULL;
+}
+
+/**
+* Searches for key and splays the node with it, or if there is none the
+* last node visited, to the root.  Returns the node with key or NULL.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+NodeT* SplayTree<Key, Value, Compare, NodeT, Alloc>::access(const Key& key)
+{
+	NodeT* parent;
+	bool left;
+	NodeT* found = search(key, parent, left);
+	if (found != NULL) {
+		splay(found);
+	} else if (parent != NULL) {
+		splay(parent);
+	}
+	return found;
+}
+
+/**
+* Rotates n up until it has no parent, two levels at a time: zig-zig
+* when n and its parent are children on the same side, which rotates the
+* parent first and roughly halves the depth of the path, and zig-zag
+* otherwise.  A single zig finishes an odd length path.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void SplayTree<Key, Value, Compare, NodeT, Alloc>::splay(NodeT* n)
+{
+	while (n->getParent() != NULL) {
+		NodeT* p = n->getParent();
+		NodeT* g = p->getParent();
+		if (g == NULL) {
+			rotateUp(n);
+		} else if ((g->getLeft() == p) == (p->getLeft() == n)) {
+			rotateUp(p);
+			rotateUp(n);
+		} else {
+			rotateUp(n);
+			rotateUp(n);
+		}
+	}
+}
+
+/**
+* Rotates n above its parent, keeping the order of the keys.  When n
+* ends up with no parent it becomes the root.
+*/
+template<class Key, class Value, class Compare, class NodeT, class Alloc>
+void SplayTree<Key, Value, Compare, NodeT, Alloc>::rotateUp(NodeT* n)
+{
+	this->counter().count(&TreeStats::rotations);
+	NodeT* p = n->getParent();
+	NodeT* g = p->getParent();
+	if (p->getLeft() == n) {
+		NodeT* inner = n->getRight();
+		p->setLeft(inner);
+		if (inner != NULL) inner->setParent(p);
+		n->setRight(p);
+	} else {
+		NodeT* inner = n->getLeft();
+		p->setRight(inner);
+		if (inner != NULL) inner->setParent(p);
+		n->setLeft(p);
+	}
+	p->setParent(n);
+	n->setParent(g);
+	if (g == NULL) {
+		this->root_ = n;
+	} else if (g->getLeft() == p) {
+		g->setLeft(n);
+	} else {
+		g->setRight(n);
+	}
+	SubtreeSize<NodeT::TRACKS_SIZE>::update(p);
+	SubtreeSize<NodeT::TRACKS_SIZE>::update(n);
+}
+
+/*
+  ---------------------------------------
+  End implementations for the SplayTree class.
+  ---------------------------------------
+*/
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef TREE_SNAPSHOT_H
+#define TREE_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bst.h"
+
+/**
+ * A binary snapshot of a sorted map, written by saveTree().  This header
+ * is opt in: bst.h does not include it, so only code that saves or loads
+ * trees pulls in the POSIX file and mapping headers.
+ *
+ * The file is a fixed header followed, at RECORDS_OFFSET, by the items in
+ * key order as an array of SnapshotRecords, exactly as they sit in memory.
+ * Only trivially copyable keys and values can be saved, and a file is only
+ * readable on a machine with the same type sizes and byte order.  Loading
+ * maps the file rather than reading it, so the records can be used in
+ * place: loadTree() builds a balanced tree from them in O(n) and
+ * MappedTree serves lookups from the mapping directly.
+ */
+template <typename Key, typename Value>
+struct SnapshotRecord
+{
+    Key first;
+    Value second;
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t keyBytes;
+    uint32_t valueBytes;
+    uint64_t recordBytes;
+    uint64_t count;
+};
+
+static const char SNAPSHOT_MAGIC[8] = { 'B', 'S', 'T', 'S', 'N', 'A', 'P', '1' };
+// Records start one cache line in, so they are aligned for any key type
+static const std::size_t RECORDS_OFFSET = 64;
+
+/**
+ * A read-only mapping of a whole file, unmapped on destruction.
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(MappedFile&& other);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const;
+    std::size_t size() const;
+
+protected:
+    char* data_;
+    std::size_t size_;
+};
+
+/**
+ * Writes n items read from first, which must be in key order, to path.
+ * The file is written under a temporary name and renamed into place, so
+ * a crash part way leaves any earlier snapshot intact.
+ */
+template <typename Key, typename Value, typename InputIt>
+void writeSnapshot(const std::string& path, InputIt first, std::size_t n)
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "snapshots hold trivially copyable keys and values only");
+    typedef SnapshotRecord<Key, Value> Record;
+    static_assert(alignof(Record) <= RECORDS_OFFSET, "record alignment exceeds the header");
+
+    std::string temp = path + ".tmp";
+    std::FILE* out = std::fopen(temp.c_str(), "wb");
+    if (out == NULL) throw std::runtime_error("snapshot: cannot create " + temp);
+
+    char head[RECORDS_OFFSET] = {};
+    SnapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.keyBytes = sizeof(Key);
+    header.valueBytes = sizeof(Value);
+    header.recordBytes = sizeof(Record);
+    header.count = n;
+    std::memcpy(head, &header, sizeof(header));
+    bool ok = std::fwrite(head, sizeof(head), 1, out) == 1;
+
+    // copy records out in chunks, so the writes are large
+    std::vector<Record> chunk;
+    chunk.reserve(4096);
+    for (std::size_t i = 0; ok && i < n; ++i, ++first) {
+        // zeroed first so that padding bytes are not written out uninitialized
+        Record r;
+        std::memset(static_cast<void*>(&r), 0, sizeof(r));
+        r.first = first->first;
+        r.second = first->second;
+        chunk.push_back(r);
+        if (chunk.size() == chunk.capacity() || i + 1 == n) {
+            ok = std::fwrite(chunk.data(), sizeof(Record), chunk.size(), out) == chunk.size();
+            chunk.clear();
+        }
+    }
+    ok = (std::fclose(out) == 0) && ok;
+    if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+        throw std::runtime_error("snapshot: cannot write " + path);
+    }
+}
+
+/**
+ * Checks that file holds a snapshot of Key/Value records and returns the
+ * first record, storing their count in n.  Throws std::runtime_error if
+ * the header does not match or the file is cut short.
+ */
+template <typename Key, typename Value>
+const SnapshotRecord<Key, Value>* snapshotRecords(const MappedFile& file, std::size_t& n)
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "snapshots hold trivially copyable keys and values only");
+    typedef SnapshotRecord<Key, Value> Record;
+
+    SnapshotHeader header;
+    if (file.size() < RECORDS_OFFSET) throw std::runtime_error("snapshot: file too short");
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.keyBytes != sizeof(Key) || header.valueBytes != sizeof(Value) ||
+        header.recordBytes != sizeof(Record)) {
+        throw std::runtime_error("snapshot: header does not match the key and value types");
+    }
+    if (header.count > (file.size() - RECORDS_OFFSET) / sizeof(Record)) {
+        throw std::runtime_error("snapshot: file too short");
+    }
+    n = header.count;
+    return reinterpret_cast<const Record*>(file.data() + RECORDS_OFFSET);
+}
+
+/**
+ * A read-only sorted map served straight from a mapped snapshot file:
+ * opening it costs one mmap and no parsing, and pages are read in as
+ * lookups touch them.  Lookups binary search the records, so Compare
+ * must order keys as the tree that saved them did.
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class MappedTree
+{
+public:
+    typedef const SnapshotRecord<Key, Value>* iterator;
+
+    explicit MappedTree(const std::string& path, const Compare& comp = Compare());
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+    Compare key_comp() const;
+    bool empty() const;
+    std::size_t size() const;
+
+protected:
+    MappedFile file_;
+    iterator records_;
+    std::size_t size_;
+    Compare comp_;
+};
+
+/**
+ * Writes the items of tree in key order to a binary snapshot at path,
+ * which loadTree() or a MappedTree can read back.  Key and Value must be
+ * trivially copyable.  Throws std::runtime_error on failure.
+ */
+template <typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+void saveTree(const BinarySearchTree<Key, Value, Compare, NodeT, Alloc>& tree, const std::string& path)
+{
+    writeSnapshot<Key, Value>(path, tree.inorder().begin(), tree.size());
+}
+
+/**
+ * Replaces the contents of tree with the snapshot at path.  The file is
+ * mapped, not parsed, and its records feed assign(), so the tree is built
+ * balanced in O(n).  The records are first checked to be in strictly
+ * increasing order under the tree's comparator, one comparison each, as
+ * assign() would otherwise build a tree that breaks the search order.
+ * Throws std::runtime_error, leaving the tree unchanged, if the file
+ * cannot be mapped, was not saved with these key and value types, or is
+ * out of order.
+ */
+template <typename Key, typename Value, typename Compare, typename NodeT, typename Alloc>
+void loadTree(BinarySearchTree<Key, Value, Compare, NodeT, Alloc>& tree, const std::string& path)
+{
+    MappedFile file(path);
+    std::size_t n;
+    const SnapshotRecord<Key, Value>* records = snapshotRecords<Key, Value>(file, n);
+    madvise(const_cast<char*>(file.data()), file.size(), MADV_SEQUENTIAL);
+    Compare comp = tree.key_comp();
+    for (std::size_t i = 1; i < n; ++i) {
+        if (!comp(records[i - 1].first, records[i].first)) {
+            throw std::runtime_error("snapshot: keys are not in strictly increasing order");
+        }
+    }
+    tree.assign(records, records + n);
+}
+
+/*
+  -----------------------------------------
+  Begin implementations for the MappedFile class.
+  -----------------------------------------
+*/
+
+/**
+* Maps path read-only.  Throws std::runtime_error if it cannot.
+*/
+inline MappedFile::MappedFile(const std::string& path) :
+    data_(NULL),
+    size_(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("snapshot: cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("snapshot: cannot stat " + path);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ > 0) {
+        void* p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("snapshot: cannot map " + path);
+        }
+        data_ = static_cast<char*>(p);
+    }
+    close(fd);
+}
+
+inline MappedFile::MappedFile(MappedFile&& other) :
+    data_(other.data_),
+    size_(other.size_)
+{
+    other.data_ = NULL;
+    other.size_ = 0;
+}
+
+inline MappedFile::~MappedFile()
+{
+    if (data_ != NULL) munmap(data_, size_);
+}
+
+inline const char* MappedFile::data() const
+{
+    return data_;
+}
+
+inline std::size_t MappedFile::size() const
+{
+    return size_;
+}
+
+/*
+  ---------------------------------------
+  End implementations for the MappedFile class.
+  ---------------------------------------
+*/
+
+/*
+  -----------------------------------------
+  Begin implementations for the MappedTree class.
+  -----------------------------------------
+*/
+
+template <typename Key, typename Value, typename Compare>
+MappedTree<Key, Value, Compare>::MappedTree(const std::string& path, const Compare& comp) :
+    file_(path),
+    comp_(comp)
+{
+    records_ = snapshotRecords<Key, Value>(file_, size_);
+}
+
+template <typename Key, typename Value, typename Compare>
+typename MappedTree<Key, Value, Compare>::iterator MappedTree<Key, Value, Compare>::begin() const
+{
+    return records_;
+}
+
+template <typename Key, typename Value, typename Compare>
+typename MappedTree<Key, Value, Compare>::iterator MappedTree<Key, Value, Compare>::end() const
+{
+    return records_ + size_;
+}
+
+template <typename Key, typename Value, typename Compare>
+typename MappedTree<Key, Value, Compare>::iterator MappedTree<Key, Value, Compare>::find(const Key& key) const
+{
+    iterator it = lower_bound(key);
+    if (it == end() || comp_(key, it->first)) return end();
+    return it;
+}
+
+template <typename Key, typename Value, typename Compare>
+typename MappedTree<Key, Value, Compare>::iterator MappedTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    const Compare& comp = comp_;
+    return std::lower_bound(begin(), end(), key,
+        [&comp](const SnapshotRecord<Key, Value>& r, const Key& k) { return comp(r.first, k); });
+}
+
+template <typename Key, typename Value, typename Compare>
+typename MappedTree<Key, Value, Compare>::iterator MappedTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    const Compare& comp = comp_;
+    return std::upper_bound(begin(), end(), key,
+        [&comp](const Key& k, const SnapshotRecord<Key, Value>& r) { return comp(k, r.first); });
+}
+
+template <typename Key, typename Value, typename Compare>
+Value const & MappedTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template <typename Key, typename Value, typename Compare>
+Compare MappedTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+template <typename Key, typename Value, typename Compare>
+bool MappedTree<Key, Value, Compare>::empty() const
+{
+    return size_ == 0;
+}
+
+template <typename Key, typename Value, typename Compare>
+std::size_t MappedTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/*
+  ---------------------------------------
+  End implementations for the MappedTree class.
+  ---------------------------------------
+*/
+
+#endif
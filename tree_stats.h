@@ -0,0 +1,130 @@
+#ifndef TREE_STATS_H
+#define TREE_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+// Build with -DBST_STATS=1 (e.g. make DEFS=-DBST_STATS=1) to count tree
+// operations; otherwise every count compiles to nothing.
+#ifndef BST_STATS
+#define BST_STATS 0
+#endif
+
+/**
+ * Operation counts for one tree, from its construction or the last
+ * resetStats().
+ */
+struct TreeStats
+{
+    constexpr TreeStats();
+
+    std::size_t comparisons;      // calls to Compare
+    std::size_t nodesVisited;     // nodes passed on the way down a search
+    std::size_t iteratorSteps;    // links followed by iterator ++ and --
+    std::size_t allocations;
+    std::size_t deallocations;
+    std::size_t rotations;        // single rotations, a double counts two
+    std::size_t insertZigZig;     // insertFix case 3, one rotation
+    std::size_t insertZigZag;     // insertFix case 3, two rotations
+    std::size_t removeCase1a;     // removeFix, child leaning the same way
+    std::size_t removeCase1b;     // removeFix, child balanced; stops
+    std::size_t removeCase1c;     // removeFix, child leaning the other way
+};
+
+inline constexpr TreeStats::TreeStats() :
+    comparisons(0),
+    nodesVisited(0),
+    iteratorSteps(0),
+    allocations(0),
+    deallocations(0),
+    rotations(0),
+    insertZigZig(0),
+    insertZigZag(0),
+    removeCase1a(0),
+    removeCase1b(0),
+    removeCase1c(0)
+{
+
+}
+
+/**
+ * The counters a tree keeps when ENABLED.  count(&TreeStats::rotations)
+ * bumps one; it is const so that lookups can count too.  The counters
+ * are relaxed atomics, so readers sharing a tree (e.g. under
+ * ConcurrentAVLTree's shared lock) may count at once; get() is a
+ * snapshot that may be mid-update.
+ */
+template <bool ENABLED>
+class StatsCounter
+{
+public:
+    StatsCounter()
+    {
+        reset();
+    }
+
+    void count(std::size_t TreeStats::* counter) const
+    {
+        counts_[slot(counter)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TreeStats get() const
+    {
+        std::size_t values[COUNTERS];
+        for (std::size_t i = 0; i < COUNTERS; ++i) {
+            values[i] = counts_[i].load(std::memory_order_relaxed);
+        }
+        TreeStats stats;
+        std::memcpy(&stats, values, sizeof(values));
+        return stats;
+    }
+
+    void reset()
+    {
+        for (std::size_t i = 0; i < COUNTERS; ++i) {
+            counts_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    static_assert(sizeof(TreeStats) % sizeof(std::size_t) == 0,
+                  "TreeStats holds nothing but size_t counters");
+    static const std::size_t COUNTERS = sizeof(TreeStats) / sizeof(std::size_t);
+
+    // Position of counter among TreeStats' members
+    static std::size_t slot(std::size_t TreeStats::* counter)
+    {
+        static constexpr TreeStats layout;
+        return (reinterpret_cast<const char*>(&(layout.*counter)) -
+                reinterpret_cast<const char*>(&layout)) / sizeof(std::size_t);
+    }
+
+    mutable std::atomic<std::size_t> counts_[COUNTERS];
+};
+
+/**
+ * Counting compiled out: nothing is stored and every count is empty.
+ * Trees inherit it, so the empty base takes no space.
+ */
+template <>
+class StatsCounter<false>
+{
+public:
+    void count(std::size_t TreeStats::*) const
+    {
+
+    }
+
+    TreeStats get() const
+    {
+        return TreeStats();
+    }
+
+    void reset()
+    {
+
+    }
+};
+
+#endif